@@ -4,6 +4,7 @@
 #include <iostream>
 #include <cctype>
 #include <algorithm>
+#include <cassert>
 
 Board::Board() { 
     clear(); 
@@ -16,12 +17,17 @@ void Board::clear() {
     for (int i = 0; i < 3; i++) {
         occupancies[i] = 0ULL;
     }
+    for (int sq = 0; sq < 64; sq++) {
+        board[sq] = EMPTY;
+    }
     side_to_move = WHITE;
     castle_rights = 0;
     enpassant_square = SQ_NONE;
     halfmove_clock = 0;
     fullmove_number = 1;
     zobrist_key = 0ULL;
+    psq = 0;
+    phase = 0;
 }
 
 void Board::set_from_fen(const std::string& fen) {
@@ -44,6 +50,9 @@ void Board::set_from_fen(const std::string& fen) {
             if (piece != EMPTY) {
                 int square = rank * 8 + file;
                 pieces[piece] |= (1ULL << square);
+                board[square] = piece;
+                psq += psq_table[piece][square];
+                phase += phase_weight[piece];
             }
             file++;
         }
@@ -97,14 +106,7 @@ std::string Board::to_fen() const {
     for (int rank = 7; rank >= 0; rank--) {
         int empty_count = 0;
         for (int file = 0; file < 8; file++) {
-            int square = rank * 8 + file;
-            char piece_char = '.';
-            for (int piece = WHITE_PAWN; piece <= BLACK_KING; piece++) {
-                if (pieces[piece] & (1ULL << square)) {
-                    piece_char = piece_to_char(piece);
-                    break;
-                }
-            }
+            char piece_char = piece_to_char(board[rank * 8 + file]);
             if (piece_char == '.') {
                 empty_count++;
             } else {
@@ -160,17 +162,45 @@ void Board::update_occupancies() {
     occupancies[2] = occupancies[WHITE] | occupancies[BLACK];
 }
 
+bool Board::bitboards_consistent() const {
+    u64 white = 0ULL, black = 0ULL;
+    for (int piece = WHITE_PAWN; piece <= WHITE_KING; piece++) white |= pieces[piece];
+    for (int piece = BLACK_PAWN; piece <= BLACK_KING; piece++) black |= pieces[piece];
+    if (occupancies[WHITE] != white || occupancies[BLACK] != black ||
+        occupancies[2] != (white | black)) return false;
+    for (int sq = 0; sq < 64; sq++) {
+        if (board[sq] != EMPTY && !(pieces[board[sq]] & (1ULL << sq))) return false;
+        if (board[sq] == EMPTY && (occupancies[2] & (1ULL << sq))) return false;
+    }
+    return true;
+}
+
+bool Board::psq_consistent() const {
+    int expected_psq = 0, expected_phase = 0;
+    for (int sq = 0; sq < 64; sq++) {
+        expected_psq += psq_table[board[sq]][sq];
+        expected_phase += phase_weight[board[sq]];
+    }
+    return psq == expected_psq && phase == expected_phase;
+}
+
 Board::UndoInfo Board::make_move(const Move& move) {
     UndoInfo undo;
     
-    // Store move components directly
-    undo.from = move.from;
-    undo.to = move.to;
-    undo.piece = move.piece;
-    undo.captured = move.captured;
-    undo.promotion = move.promotion;
-    undo.isEnPassant = move.isEnPassant;
-    undo.isCastle = move.isCastle;
+    // Unpack the move against the current position
+    const int from = move.from();
+    const int to = move.to();
+    const int piece = moved_piece(move);
+    const int captured = captured_piece(move);
+    const int promotion = move.is_promotion() ? move.promotion_piece(side_to_move) : EMPTY;
+    
+    undo.from = from;
+    undo.to = to;
+    undo.piece = piece;
+    undo.captured = captured;
+    undo.promotion = promotion;
+    undo.isEnPassant = move.is_enpassant();
+    undo.isCastle = move.is_castle();
     
     // Save current state
     undo.castle_rights = castle_rights;
@@ -178,69 +208,77 @@ Board::UndoInfo Board::make_move(const Move& move) {
     undo.halfmove = halfmove_clock;
     undo.zobrist_key = zobrist_key;
 
-    pieces[move.piece] &= ~(1ULL << move.from);
+    remove_piece(piece, from);
 
-    if (move.isEnPassant) {
-        int capture_square = (side_to_move == WHITE) ? move.to - 8 : move.to + 8;
-        pieces[move.captured] &= ~(1ULL << capture_square);
-    } else if (move.captured != EMPTY) {
-        pieces[move.captured] &= ~(1ULL << move.to);
+    if (move.is_enpassant()) {
+        int capture_square = (side_to_move == WHITE) ? to - 8 : to + 8;
+        remove_piece(captured, capture_square);
+    } else if (captured != EMPTY) {
+        remove_piece(captured, to);
     }
 
-    if (move.promotion != EMPTY) {
-        pieces[move.promotion] |= (1ULL << move.to);
+    if (promotion != EMPTY) {
+        add_piece(promotion, to);
     } else {
-        pieces[move.piece] |= (1ULL << move.to);
-    }
-
-    if (move.isCastle) {
-        if (move.to == 62) {
-            pieces[WHITE_ROOK] &= ~(1ULL << 63);
-            pieces[WHITE_ROOK] |= (1ULL << 61);
-        } else if (move.to == 58) {
-            pieces[WHITE_ROOK] &= ~(1ULL << 56);
-            pieces[WHITE_ROOK] |= (1ULL << 59);
-        } else if (move.to == 6) {
-            pieces[BLACK_ROOK] &= ~(1ULL << 7);
-            pieces[BLACK_ROOK] |= (1ULL << 5);
-        } else if (move.to == 2) {
-            pieces[BLACK_ROOK] &= ~(1ULL << 0);
-            pieces[BLACK_ROOK] |= (1ULL << 3);
-        }
+        add_piece(piece, to);
     }
 
-    update_occupancies();
+    if (move.is_castle()) {
+        if (to == 6) {
+            remove_piece(WHITE_ROOK, 7);
+            add_piece(WHITE_ROOK, 5);
+        } else if (to == 2) {
+            remove_piece(WHITE_ROOK, 0);
+            add_piece(WHITE_ROOK, 3);
+        } else if (to == 62) {
+            remove_piece(BLACK_ROOK, 63);
+            add_piece(BLACK_ROOK, 61);
+        } else if (to == 58) {
+            remove_piece(BLACK_ROOK, 56);
+            add_piece(BLACK_ROOK, 59);
+        }
+    }
 
-    if (move.piece == WHITE_KING) {
+    if (piece == WHITE_KING) {
         castle_rights &= ~(1 | 2);
-    } else if (move.piece == BLACK_KING) {
+    } else if (piece == BLACK_KING) {
         castle_rights &= ~(4 | 8);
     }
 
-    if (move.piece == WHITE_ROOK) {
-        if (move.from == 63) castle_rights &= ~1;
-        if (move.from == 56) castle_rights &= ~2;
-    } else if (move.piece == BLACK_ROOK) {
-        if (move.from == 7) castle_rights &= ~4;
-        if (move.from == 0) castle_rights &= ~8;
+    if (piece == WHITE_ROOK) {
+        if (from == 7) castle_rights &= ~1;
+        if (from == 0) castle_rights &= ~2;
+    } else if (piece == BLACK_ROOK) {
+        if (from == 63) castle_rights &= ~4;
+        if (from == 56) castle_rights &= ~8;
     }
 
-    if (move.captured == WHITE_ROOK) {
-        if (move.to == 63) castle_rights &= ~1;
-        if (move.to == 56) castle_rights &= ~2;
-    } else if (move.captured == BLACK_ROOK) {
-        if (move.to == 7) castle_rights &= ~4;
-        if (move.to == 0) castle_rights &= ~8;
+    if (captured == WHITE_ROOK) {
+        if (to == 7) castle_rights &= ~1;
+        if (to == 0) castle_rights &= ~2;
+    } else if (captured == BLACK_ROOK) {
+        if (to == 63) castle_rights &= ~4;
+        if (to == 56) castle_rights &= ~8;
+    }
+    
+    if (castle_rights != undo.castle_rights) {
+        zobrist_key ^= zobrist_castle[undo.castle_rights] ^ zobrist_castle[castle_rights];
     }
 
+    if (enpassant_square != SQ_NONE) {
+        zobrist_key ^= zobrist_enpassant[enpassant_square];
+    }
     enpassant_square = SQ_NONE;
-    if (move.piece == WHITE_PAWN && (move.to - move.from) == 16) {
-        enpassant_square = move.from + 8;
-    } else if (move.piece == BLACK_PAWN && (move.from - move.to) == 16) {
-        enpassant_square = move.from - 8;
+    if (piece == WHITE_PAWN && (to - from) == 16) {
+        enpassant_square = from + 8;
+    } else if (piece == BLACK_PAWN && (from - to) == 16) {
+        enpassant_square = from - 8;
+    }
+    if (enpassant_square != SQ_NONE) {
+        zobrist_key ^= zobrist_enpassant[enpassant_square];
     }
 
-    if (move.piece == WHITE_PAWN || move.piece == BLACK_PAWN || move.captured != EMPTY) {
+    if (piece == WHITE_PAWN || piece == BLACK_PAWN || captured != EMPTY) {
         halfmove_clock = 0;
     } else {
         halfmove_clock++;
@@ -251,12 +289,47 @@ Board::UndoInfo Board::make_move(const Move& move) {
     }
 
     side_to_move = (side_to_move == WHITE) ? BLACK : WHITE;
+    zobrist_key ^= zobrist_side;
 
-    zobrist_key = compute_zobrist_key(*this);
+    assert(zobrist_key == compute_zobrist_key(*this));
+    assert(bitboards_consistent());
+    assert(psq_consistent());
+
+    return undo;
+}
 
+Board::UndoInfo Board::make_null_move() {
+    UndoInfo undo;
+    undo.from = undo.to = 0;
+    undo.piece = undo.captured = undo.promotion = EMPTY;
+    undo.isEnPassant = undo.isCastle = false;
+    
+    undo.castle_rights = castle_rights;
+    undo.enpassant = enpassant_square;
+    undo.halfmove = halfmove_clock;
+    undo.zobrist_key = zobrist_key;
+    
+    if (enpassant_square != SQ_NONE) {
+        zobrist_key ^= zobrist_enpassant[enpassant_square];
+        enpassant_square = SQ_NONE;
+    }
+    halfmove_clock++;
+    
+    side_to_move = (side_to_move == WHITE) ? BLACK : WHITE;
+    zobrist_key ^= zobrist_side;
+    
+    assert(zobrist_key == compute_zobrist_key(*this));
+    
     return undo;
 }
 
+void Board::undo_null_move(const UndoInfo& undo) {
+    side_to_move = (side_to_move == WHITE) ? BLACK : WHITE;
+    halfmove_clock = undo.halfmove;
+    enpassant_square = undo.enpassant;
+    zobrist_key = undo.zobrist_key;
+}
+
 void Board::undo_move(const UndoInfo& undo) {
     // Switch side back first
     side_to_move = (side_to_move == WHITE) ? BLACK : WHITE;
@@ -269,51 +342,45 @@ void Board::undo_move(const UndoInfo& undo) {
     enpassant_square = undo.enpassant;
 
     if (undo.promotion != EMPTY) {
-        pieces[undo.promotion] &= ~(1ULL << undo.to);
+        remove_piece(undo.promotion, undo.to);
     } else {
-        pieces[undo.piece] &= ~(1ULL << undo.to);
+        remove_piece(undo.piece, undo.to);
     }
-    pieces[undo.piece] |= (1ULL << undo.from);
+    add_piece(undo.piece, undo.from);
 
     if (undo.isEnPassant) {
         int capture_square = (side_to_move == WHITE) ? undo.to - 8 : undo.to + 8;
-        pieces[undo.captured] |= (1ULL << capture_square);
+        add_piece(undo.captured, capture_square);
     } else if (undo.captured != EMPTY) {
-        pieces[undo.captured] |= (1ULL << undo.to);
+        add_piece(undo.captured, undo.to);
     }
 
     if (undo.isCastle) {
-        if (undo.to == 62) {
-            pieces[WHITE_ROOK] &= ~(1ULL << 61);
-            pieces[WHITE_ROOK] |= (1ULL << 63);
-        } else if (undo.to == 58) {
-            pieces[WHITE_ROOK] &= ~(1ULL << 59);
-            pieces[WHITE_ROOK] |= (1ULL << 56);
-        } else if (undo.to == 6) {
-            pieces[BLACK_ROOK] &= ~(1ULL << 5);
-            pieces[BLACK_ROOK] |= (1ULL << 7);
+        if (undo.to == 6) {
+            remove_piece(WHITE_ROOK, 5);
+            add_piece(WHITE_ROOK, 7);
         } else if (undo.to == 2) {
-            pieces[BLACK_ROOK] &= ~(1ULL << 3);
-            pieces[BLACK_ROOK] |= (1ULL << 0);
+            remove_piece(WHITE_ROOK, 3);
+            add_piece(WHITE_ROOK, 0);
+        } else if (undo.to == 62) {
+            remove_piece(BLACK_ROOK, 61);
+            add_piece(BLACK_ROOK, 63);
+        } else if (undo.to == 58) {
+            remove_piece(BLACK_ROOK, 59);
+            add_piece(BLACK_ROOK, 56);
         }
     }
 
-    update_occupancies();
+    // The piece updates above also touched the key; the saved one is exact
     zobrist_key = undo.zobrist_key;
+    assert(bitboards_consistent());
+    assert(psq_consistent());
 }
 
 bool Board::is_square_attacked(int square, Color attacker) const {
-    if (attacker == WHITE) {
-        if (file_of(square) > 0 && rank_of(square) < 7 && 
-            (pieces[WHITE_PAWN] & (1ULL << (square + 7)))) return true;
-        if (file_of(square) < 7 && rank_of(square) < 7 && 
-            (pieces[WHITE_PAWN] & (1ULL << (square + 9)))) return true;
-    } else {
-        if (file_of(square) > 0 && rank_of(square) > 0 && 
-            (pieces[BLACK_PAWN] & (1ULL << (square - 9)))) return true;
-        if (file_of(square) < 7 && rank_of(square) > 0 && 
-            (pieces[BLACK_PAWN] & (1ULL << (square - 7)))) return true;
-    }
+    // A pawn attacks the square if a pawn of the other colour there would attack it
+    u64 attacker_pawns = (attacker == WHITE) ? pieces[WHITE_PAWN] : pieces[BLACK_PAWN];
+    if (pawn_attacks[!attacker][square] & attacker_pawns) return true;
 
     u64 knight_attacks = knight_moves[square];
     u64 attacker_knights = (attacker == WHITE) ? pieces[WHITE_KNIGHT] : pieces[BLACK_KNIGHT];
@@ -323,21 +390,32 @@ bool Board::is_square_attacked(int square, Color attacker) const {
     u64 attacker_king = (attacker == WHITE) ? pieces[WHITE_KING] : pieces[BLACK_KING];
     if (king_attacks & attacker_king) return true;
 
-    u64 bishop_attacks = get_slider_attacks(square, *this, true, false);
+    u64 diagonal_attacks = bishop_attacks(square, occupancies[2]);
     u64 attacker_bishops_queens = (attacker == WHITE) ? 
         (pieces[WHITE_BISHOP] | pieces[WHITE_QUEEN]) : 
         (pieces[BLACK_BISHOP] | pieces[BLACK_QUEEN]);
-    if (bishop_attacks & attacker_bishops_queens) return true;
+    if (diagonal_attacks & attacker_bishops_queens) return true;
 
-    u64 rook_attacks = get_slider_attacks(square, *this, false, true);
+    u64 straight_attacks = rook_attacks(square, occupancies[2]);
     u64 attacker_rooks_queens = (attacker == WHITE) ? 
         (pieces[WHITE_ROOK] | pieces[WHITE_QUEEN]) : 
         (pieces[BLACK_ROOK] | pieces[BLACK_QUEEN]);
-    if (rook_attacks & attacker_rooks_queens) return true;
+    if (straight_attacks & attacker_rooks_queens) return true;
 
     return false;
 }
 
+u64 Board::attackers_to(int square, u64 occupancy) const {
+    return (pawn_attacks[BLACK][square] & pieces[WHITE_PAWN]) |
+           (pawn_attacks[WHITE][square] & pieces[BLACK_PAWN]) |
+           (knight_moves[square] & (pieces[WHITE_KNIGHT] | pieces[BLACK_KNIGHT])) |
+           (king_moves[square] & (pieces[WHITE_KING] | pieces[BLACK_KING])) |
+           (bishop_attacks(square, occupancy) & (pieces[WHITE_BISHOP] | pieces[BLACK_BISHOP] |
+                                                 pieces[WHITE_QUEEN] | pieces[BLACK_QUEEN])) |
+           (rook_attacks(square, occupancy) & (pieces[WHITE_ROOK] | pieces[BLACK_ROOK] |
+                                               pieces[WHITE_QUEEN] | pieces[BLACK_QUEEN]));
+}
+
 bool Board::in_check(Color side) const {
     int king_square = SQ_NONE;
     u64 kings = (side == WHITE) ? pieces[WHITE_KING] : pieces[BLACK_KING];
@@ -2,22 +2,24 @@
 #define BOARD_H
 
 #include "utils.h"
+#include "moves.h"
+#include "psqt.h"
 #include <string>
 #include <cstring>
 
-// Forward declaration only
-struct Move;
-
 class Board {
 public:
     u64 pieces[13];
     u64 occupancies[3];
+    int board[64]; // Piece on each square, EMPTY if none
     Color side_to_move;
     int castle_rights;
     int enpassant_square;
     int halfmove_clock;
     int fullmove_number;
     u64 zobrist_key;
+    int psq;   // Packed mg/eg material and piece-square sum, white's view
+    int phase; // Sum of phase_weight over the pieces on the board
 
     Board();
     void clear();
@@ -43,12 +45,48 @@ public:
     
     UndoInfo make_move(const Move& move);
     void undo_move(const UndoInfo& undo);
+    UndoInfo make_null_move();
+    void undo_null_move(const UndoInfo& undo);
+    
+    int piece_on(int square) const { return board[square]; }
+    int moved_piece(const Move& move) const { return board[move.from()]; }
+    int captured_piece(const Move& move) const {
+        if (move.is_enpassant()) return side_to_move == WHITE ? BLACK_PAWN : WHITE_PAWN;
+        return board[move.to()];
+    }
+    bool is_capture(const Move& move) const { return captured_piece(move) != EMPTY; }
     
     bool is_square_attacked(int square, Color attacker) const;
+    u64 attackers_to(int square, u64 occupancy) const; // Both colours
     bool in_check(Color side) const;
     
 private:
     void update_occupancies();
+    bool bitboards_consistent() const;
+    bool psq_consistent() const;
+    
+    // Bitboard updates that keep occupancies, zobrist_key and the
+    // evaluation accumulators in step
+    void add_piece(int piece, int square) {
+        u64 bb = 1ULL << square;
+        pieces[piece] |= bb;
+        board[square] = piece;
+        occupancies[piece_color(piece)] |= bb;
+        occupancies[2] |= bb;
+        zobrist_key ^= zobrist_piece[piece][square];
+        psq += psq_table[piece][square];
+        phase += phase_weight[piece];
+    }
+    void remove_piece(int piece, int square) {
+        u64 bb = 1ULL << square;
+        pieces[piece] &= ~bb;
+        board[square] = EMPTY;
+        occupancies[piece_color(piece)] &= ~bb;
+        occupancies[2] &= ~bb;
+        zobrist_key ^= zobrist_piece[piece][square];
+        psq -= psq_table[piece][square];
+        phase -= phase_weight[piece];
+    }
 };
 
 #endif
\ No newline at end of file
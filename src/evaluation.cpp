@@ -2,14 +2,14 @@
 #include "moves.h"
 
 // Piece values (centipawns)
-const int PIECE_VALUES[13] = {
+constexpr int PIECE_VALUES[13] = {
     0, 
     100, 320, 330, 500, 900, 20000,  // white pieces
     -100, -320, -330, -500, -900, -20000  // black pieces
 };
 
 // Middle-game piece-square tables
-int mg_pawn_table[64] = {
+constexpr std::array<int, 64> mg_pawn_table = {
      0,   0,   0,   0,   0,   0,   0,   0,
     50,  50,  50,  50,  50,  50,  50,  50,
     10,  10,  20,  30,  30,  20,  10,  10,
@@ -20,7 +20,7 @@ int mg_pawn_table[64] = {
      0,   0,   0,   0,   0,   0,   0,   0
 };
 
-int mg_knight_table[64] = {
+constexpr std::array<int, 64> mg_knight_table = {
     -50, -40, -30, -30, -30, -30, -40, -50,
     -40, -20,   0,   0,   0,   0, -20, -40,
     -30,   0,  10,  15,  15,  10,   0, -30,
@@ -31,7 +31,7 @@ int mg_knight_table[64] = {
     -50, -40, -30, -30, -30, -30, -40, -50
 };
 
-int mg_bishop_table[64] = {
+constexpr std::array<int, 64> mg_bishop_table = {
     -20, -10, -10, -10, -10, -10, -10, -20,
     -10,   0,   0,   0,   0,   0,   0, -10,
     -10,   0,   5,  10,  10,   5,   0, -10,
@@ -42,7 +42,7 @@ int mg_bishop_table[64] = {
     -20, -10, -10, -10, -10, -10, -10, -20
 };
 
-int mg_rook_table[64] = {
+constexpr std::array<int, 64> mg_rook_table = {
      0,   0,   0,   0,   0,   0,   0,   0,
      5,  10,  10,  10,  10,  10,  10,   5,
     -5,   0,   0,   0,   0,   0,   0,  -5,
@@ -53,7 +53,7 @@ int mg_rook_table[64] = {
      0,   0,   0,   5,   5,   0,   0,   0
 };
 
-int mg_queen_table[64] = {
+constexpr std::array<int, 64> mg_queen_table = {
     -20, -10, -10, -5, -5, -10, -10, -20,
     -10,   0,   0,   0,   0,   0,   0, -10,
     -10,   0,   5,   5,   5,   5,   0, -10,
@@ -64,7 +64,7 @@ int mg_queen_table[64] = {
     -20, -10, -10, -5, -5, -10, -10, -20
 };
 
-int mg_king_table[64] = {
+constexpr std::array<int, 64> mg_king_table = {
     -30, -40, -40, -50, -50, -40, -40, -30,
     -30, -40, -40, -50, -50, -40, -40, -30,
     -30, -40, -40, -50, -50, -40, -40, -30,
@@ -76,27 +76,51 @@ int mg_king_table[64] = {
 };
 
 // End-game tables (simplified - same as MG for now)
-int eg_pawn_table[64];
-int eg_knight_table[64];
-int eg_bishop_table[64];
-int eg_rook_table[64];
-int eg_queen_table[64];
-int eg_king_table[64];
-
-void init_evaluation_tables() {
-    // Initialize endgame tables (for now, same as middle game)
-    for (int i = 0; i < 64; i++) {
-        eg_pawn_table[i] = mg_pawn_table[i];
-        eg_knight_table[i] = mg_knight_table[i];
-        eg_bishop_table[i] = mg_bishop_table[i];
-        eg_rook_table[i] = mg_rook_table[i];
-        eg_queen_table[i] = mg_queen_table[i];
-        eg_king_table[i] = mg_king_table[i];
+constexpr std::array<int, 64> eg_pawn_table = mg_pawn_table;
+constexpr std::array<int, 64> eg_knight_table = mg_knight_table;
+constexpr std::array<int, 64> eg_bishop_table = mg_bishop_table;
+constexpr std::array<int, 64> eg_rook_table = mg_rook_table;
+constexpr std::array<int, 64> eg_queen_table = mg_queen_table;
+constexpr std::array<int, 64> eg_king_table = mg_king_table;
+
+// Material and piece-square value of every piece on every square. The
+// tables above are laid out rank 8 first, so white reads them through
+// sq ^ 56 and black, seeing the board from the other side, reads sq as is.
+// King material is left out: both kings are always on the board, and it
+// would not fit in the 16-bit halves of a packed score.
+constexpr std::array<std::array<int, 64>, 13> psq_table = [] {
+    const std::array<int, 64>* mg_tables[7] = {
+        nullptr, &mg_pawn_table, &mg_knight_table, &mg_bishop_table,
+        &mg_rook_table, &mg_queen_table, &mg_king_table
+    };
+    const std::array<int, 64>* eg_tables[7] = {
+        nullptr, &eg_pawn_table, &eg_knight_table, &eg_bishop_table,
+        &eg_rook_table, &eg_queen_table, &eg_king_table
+    };
+
+    std::array<std::array<int, 64>, 13> table{};
+    for (int type = 1; type <= 6; type++) {
+        int value = type == 6 ? 0 : PIECE_VALUES[type];
+        for (int sq = 0; sq < 64; sq++) {
+            table[type][sq] = make_score(value + (*mg_tables[type])[sq ^ 56],
+                                         value + (*eg_tables[type])[sq ^ 56]);
+            table[type + 6][sq] = -make_score(value + (*mg_tables[type])[sq],
+                                              value + (*eg_tables[type])[sq]);
+        }
     }
-}
+    return table;
+}();
 
+constexpr std::array<int, 13> phase_weight = {
+    0,
+    0, 1, 1, 2, 4, 0,  // white pieces
+    0, 1, 1, 2, 4, 0   // black pieces
+};
+
+// Board keeps psq and phase up to date as pieces move, so the base
+// evaluation is a single interpolation
 int Evaluator::evaluate(const Board& board) {
-    int score = evaluate_material(board) + evaluate_positional(board);
+    int score = interpolate(mg_value(board.psq), eg_value(board.psq), get_game_phase(board));
     return (board.side_to_move == WHITE) ? score : -score;
 }
 
@@ -109,45 +133,46 @@ int Evaluator::evaluate_material(const Board& board) {
     return score;
 }
 
+// From-scratch piece-square sum, kept as a reference for the accumulator
 int Evaluator::evaluate_positional(const Board& board) {
     int mg_score = 0, eg_score = 0;
     
-    // Piece-square tables
     for (int p = 1; p <= 12; p++) {
         u64 bb = board.pieces[p];
         bool is_white = p <= 6;
+        int sign = is_white ? 1 : -1;
         
         while (bb) {
             int sq = bit_scan_forward(bb);
             bb &= bb - 1;
             
-            // Flip square for black pieces
-            int eval_sq = is_white ? sq : 63 - sq;
+            // Tables are laid out rank 8 first, as seen by white
+            int eval_sq = is_white ? sq ^ 56 : sq;
             
             switch (p) {
                 case WHITE_PAWN: case BLACK_PAWN:
-                    mg_score += mg_pawn_table[eval_sq];
-                    eg_score += eg_pawn_table[eval_sq];
+                    mg_score += sign * mg_pawn_table[eval_sq];
+                    eg_score += sign * eg_pawn_table[eval_sq];
                     break;
                 case WHITE_KNIGHT: case BLACK_KNIGHT:
-                    mg_score += mg_knight_table[eval_sq];
-                    eg_score += eg_knight_table[eval_sq];
+                    mg_score += sign * mg_knight_table[eval_sq];
+                    eg_score += sign * eg_knight_table[eval_sq];
                     break;
                 case WHITE_BISHOP: case BLACK_BISHOP:
-                    mg_score += mg_bishop_table[eval_sq];
-                    eg_score += eg_bishop_table[eval_sq];
+                    mg_score += sign * mg_bishop_table[eval_sq];
+                    eg_score += sign * eg_bishop_table[eval_sq];
                     break;
                 case WHITE_ROOK: case BLACK_ROOK:
-                    mg_score += mg_rook_table[eval_sq];
-                    eg_score += eg_rook_table[eval_sq];
+                    mg_score += sign * mg_rook_table[eval_sq];
+                    eg_score += sign * eg_rook_table[eval_sq];
                     break;
                 case WHITE_QUEEN: case BLACK_QUEEN:
-                    mg_score += mg_queen_table[eval_sq];
-                    eg_score += eg_queen_table[eval_sq];
+                    mg_score += sign * mg_queen_table[eval_sq];
+                    eg_score += sign * eg_queen_table[eval_sq];
                     break;
                 case WHITE_KING: case BLACK_KING:
-                    mg_score += mg_king_table[eval_sq];
-                    eg_score += eg_king_table[eval_sq];
+                    mg_score += sign * mg_king_table[eval_sq];
+                    eg_score += sign * eg_king_table[eval_sq];
                     break;
             }
         }
@@ -158,16 +183,8 @@ int Evaluator::evaluate_positional(const Board& board) {
 }
 
 int Evaluator::get_game_phase(const Board& board) {
-    // Simple game phase calculation based on material
-    int phase = 0;
-    phase += popcount(board.pieces[WHITE_QUEEN] | board.pieces[BLACK_QUEEN]) * 4;
-    phase += popcount(board.pieces[WHITE_ROOK] | board.pieces[BLACK_ROOK]) * 2;
-    phase += popcount(board.pieces[WHITE_BISHOP] | board.pieces[BLACK_BISHOP] | 
-                     board.pieces[WHITE_KNIGHT] | board.pieces[BLACK_KNIGHT]);
-    
-    // Normalize to 0-256 range
-    phase = std::min(24, phase) * 256 / 24;
-    return phase;
+    // Normalize to 0-256 range; promotions can push the count past the max
+    return std::min(MAX_PHASE, board.phase) * 256 / MAX_PHASE;
 }
 
 int Evaluator::interpolate(int mg_score, int eg_score, int phase) {
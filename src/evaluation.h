@@ -2,26 +2,28 @@
 #define EVALUATION_H
 
 #include "board.h"
+#include <cstdlib>
 
-// Piece values (centipawns)
+// Piece values (centipawns), negative for black
 extern const int PIECE_VALUES[13];
 
-// Piece-square tables
-extern int mg_pawn_table[64];
-extern int mg_knight_table[64];
-extern int mg_bishop_table[64];
-extern int mg_rook_table[64];
-extern int mg_queen_table[64];
-extern int mg_king_table[64];
+// Value of a piece regardless of color
+inline int piece_value(int piece) { return std::abs(PIECE_VALUES[piece]); }
 
-extern int eg_pawn_table[64];
-extern int eg_knight_table[64];
-extern int eg_bishop_table[64];
-extern int eg_rook_table[64];
-extern int eg_queen_table[64];
-extern int eg_king_table[64];
+// Piece-square tables, built at compile time
+extern const std::array<int, 64> mg_pawn_table;
+extern const std::array<int, 64> mg_knight_table;
+extern const std::array<int, 64> mg_bishop_table;
+extern const std::array<int, 64> mg_rook_table;
+extern const std::array<int, 64> mg_queen_table;
+extern const std::array<int, 64> mg_king_table;
 
-void init_evaluation_tables();
+extern const std::array<int, 64> eg_pawn_table;
+extern const std::array<int, 64> eg_knight_table;
+extern const std::array<int, 64> eg_bishop_table;
+extern const std::array<int, 64> eg_rook_table;
+extern const std::array<int, 64> eg_queen_table;
+extern const std::array<int, 64> eg_king_table;
 
 class Evaluator {
 public:
@@ -11,7 +11,7 @@ Board board;
 Searcher searcher;
 
 void init_engine() {
-    init_zobrist();
+    init_move_tables();
     
     std::cout << "YM07 Chess Engine initialized" << std::endl;
 }
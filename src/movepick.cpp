@@ -0,0 +1,235 @@
+#include "movepick.h"
+#include "evaluation.h"
+#include <algorithm>
+#include <utility>
+
+int see(const Board& board, const Move& move) {
+    if (move.is_castle()) return 0;
+    
+    const int from = move.from();
+    const int to = move.to();
+    const u64 bishops = board.pieces[WHITE_BISHOP] | board.pieces[BLACK_BISHOP]
+                      | board.pieces[WHITE_QUEEN] | board.pieces[BLACK_QUEEN];
+    const u64 rooks = board.pieces[WHITE_ROOK] | board.pieces[BLACK_ROOK]
+                    | board.pieces[WHITE_QUEEN] | board.pieces[BLACK_QUEEN];
+    
+    int gain[32];
+    int depth = 0;
+    u64 occ = board.occupancies[2];
+    
+    // The value standing on the square after the move, and what it cost
+    int on_square = piece_value(board.moved_piece(move));
+    gain[0] = piece_value(board.captured_piece(move));
+    if (move.is_promotion()) {
+        on_square = piece_value(move.promotion_piece(board.side_to_move));
+        gain[0] += on_square - piece_value(WHITE_PAWN);
+    }
+    if (move.is_enpassant()) occ ^= 1ULL << (to + (board.side_to_move == WHITE ? -8 : 8));
+    
+    u64 attackers = board.attackers_to(to, occ);
+    u64 from_bb = 1ULL << from;
+    Color side = board.side_to_move;
+    
+    while (true) {
+        depth++;
+        side = (Color)!side;
+        
+        // Speculative score if this side recaptures; stop once neither
+        // continuing nor standing pat can change the outcome
+        gain[depth] = on_square - gain[depth - 1];
+        if (std::max(-gain[depth - 1], gain[depth]) < 0) break;
+        
+        // Lifting the last capturer may uncover a slider behind it
+        occ ^= from_bb;
+        attackers |= (bishop_attacks(to, occ) & bishops) | (rook_attacks(to, occ) & rooks);
+        attackers &= occ;
+        
+        u64 ours = attackers & board.occupancies[side];
+        if (!ours) break;
+        
+        // Least valuable attacker next
+        int first = side == WHITE ? WHITE_PAWN : BLACK_PAWN;
+        int piece = first;
+        while (!(board.pieces[piece] & ours)) piece++;
+        from_bb = lsb(board.pieces[piece] & ours);
+        on_square = piece_value(piece);
+        
+        if (depth == 31) break;
+    }
+    
+    // Each side picks the better of capturing on or stopping, back to front
+    while (--depth) gain[depth - 1] = -std::max(-gain[depth - 1], gain[depth]);
+    return gain[0];
+}
+
+MovePicker::MovePicker(const Board& b, Move tt, const Move* killer_moves, Move counter,
+                       const ButterflyHistory* history, const PieceToHistory* cont[2])
+    : board(b), tt_move(tt), countermove(counter), butterfly(history) {
+    killers[0] = killer_moves[0];
+    killers[1] = killer_moves[1];
+    continuation[0] = cont[0];
+    continuation[1] = cont[1];
+    
+    // The hash move may come from a colliding position, so it is checked
+    // here instead of being looked up in a generated list
+    stage = (!tt_move.is_null() && MoveGenerator::is_legal(board, tt_move)) ? TT_MOVE : CAPTURE_INIT;
+}
+
+MovePicker::MovePicker(const Board& b, Move tt, bool in_check) : board(b), tt_move(tt) {
+    // Out of check only a capturing or promoting hash move belongs here
+    bool usable = !tt_move.is_null() && (in_check || board.is_capture(tt_move) || tt_move.is_promotion())
+               && MoveGenerator::is_legal(board, tt_move);
+    if (!usable) tt_move = Move();
+    
+    evasions = in_check;
+    stage = usable ? QS_TT_MOVE : (in_check ? EVASION_INIT : QS_CAPTURE_INIT);
+}
+
+void MovePicker::score_captures() {
+    // MVV-LVA, queen promotions on top
+    for (int i = 0; i < moves.count; i++) {
+        const Move& move = moves[i];
+        moves.scores[i] = piece_value(board.captured_piece(move)) * 16 - piece_value(board.moved_piece(move));
+        if (move.is_promotion()) moves.scores[i] += piece_value(move.promotion_piece(board.side_to_move)) * 16;
+    }
+}
+
+void MovePicker::score_quiets() {
+    for (int i = 0; i < moves.count; i++) {
+        const Move& move = moves[i];
+        int piece = board.moved_piece(move);
+        moves.scores[i] = (*butterfly)[move.from_to()];
+        for (const PieceToHistory* table : continuation) {
+            if (table) moves.scores[i] += (*table)[piece][move.to()];
+        }
+    }
+}
+
+void MovePicker::score_evasions() {
+    // Capturing the checker first, then by MVV-LVA; king steps and blocks after
+    for (int i = 0; i < moves.count; i++) {
+        const Move& move = moves[i];
+        moves.scores[i] = board.is_capture(move)
+            ? (1 << 20) + piece_value(board.captured_piece(move)) * 16 - piece_value(board.moved_piece(move))
+            : 0;
+    }
+}
+
+// One step of selection sort: cheaper than sorting when only the first
+// few moves are ever asked for
+Move MovePicker::select_best() {
+    int best = current;
+    for (int i = current + 1; i < moves.count; i++) {
+        if (moves.scores[i] > moves.scores[best]) best = i;
+    }
+    std::swap(moves.moves[current], moves.moves[best]);
+    std::swap(moves.scores[current], moves.scores[best]);
+    return moves[current++];
+}
+
+// Moves handed out by an earlier stage
+bool MovePicker::is_special(const Move& move) const {
+    return move == tt_move || move == killers[0] || move == killers[1] || move == countermove;
+}
+
+Move MovePicker::next_move() {
+    switch (stage) {
+    case TT_MOVE:
+        stage = CAPTURE_INIT;
+        return tt_move;
+        
+    case CAPTURE_INIT:
+        MoveGenerator::generate_captures(board, moves);
+        score_captures();
+        current = 0;
+        stage = GOOD_CAPTURES;
+        // fallthrough
+    case GOOD_CAPTURES:
+        while (current < moves.count) {
+            Move move = select_best();
+            if (move == tt_move) continue;
+            
+            // Losing exchanges and underpromotions wait until after the quiets
+            bool under = move.is_promotion() && move.flag() != MF_PROMO_QUEEN;
+            if (under || see(board, move) < 0) {
+                bad_captures.push_back(move);
+                continue;
+            }
+            return move;
+        }
+        stage = KILLER_1;
+        // fallthrough
+    case KILLER_1:
+    case KILLER_2:
+        while (stage != COUNTERMOVE) {
+            Move killer = killers[stage - KILLER_1];
+            stage++;
+            if (killer != tt_move && !board.is_capture(killer) && !killer.is_promotion()
+                && MoveGenerator::is_legal(board, killer)) {
+                return killer;
+            }
+        }
+        // fallthrough
+    case COUNTERMOVE:
+        stage = QUIET_INIT;
+        if (countermove != tt_move && countermove != killers[0] && countermove != killers[1]
+            && !board.is_capture(countermove) && !countermove.is_promotion()
+            && MoveGenerator::is_legal(board, countermove)) {
+            return countermove;
+        }
+        // fallthrough
+    case QUIET_INIT:
+        MoveGenerator::generate_quiets(board, moves);
+        score_quiets();
+        current = 0;
+        stage = QUIETS;
+        // fallthrough
+    case QUIETS:
+        while (current < moves.count) {
+            Move move = select_best();
+            if (!is_special(move)) return move;
+        }
+        current = 0;
+        stage = BAD_CAPTURES;
+        // fallthrough
+    case BAD_CAPTURES:
+        if (current < bad_captures.count) return bad_captures[current++];
+        stage = DONE;
+        return Move();
+        
+    case QS_TT_MOVE:
+        stage = evasions ? EVASION_INIT : QS_CAPTURE_INIT;
+        return tt_move;
+        
+    case QS_CAPTURE_INIT:
+        MoveGenerator::generate_captures(board, moves);
+        score_captures();
+        current = 0;
+        stage = QS_CAPTURES;
+        // fallthrough
+    case QS_CAPTURES:
+        while (current < moves.count) {
+            Move move = select_best();
+            if (move != tt_move) return move;
+        }
+        stage = DONE;
+        return Move();
+        
+    case EVASION_INIT:
+        MoveGenerator::generate_moves(board, moves);
+        score_evasions();
+        current = 0;
+        stage = EVASIONS;
+        // fallthrough
+    case EVASIONS:
+        while (current < moves.count) {
+            Move move = select_best();
+            if (move != tt_move) return move;
+        }
+        stage = DONE;
+        return Move();
+        
+    default:
+        return Move();
+    }
+}
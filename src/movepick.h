@@ -0,0 +1,61 @@
+#ifndef MOVEPICK_H
+#define MOVEPICK_H
+
+#include "board.h"
+#include "moves.h"
+
+// Quiet move statistics, kept within +/-MAX_HISTORY by the gravity update
+constexpr int MAX_HISTORY = 16384;
+using ButterflyHistory = int[64 * 64];  // [Move::from_to()], one per color
+using PieceToHistory = int16_t[13][64]; // [piece][to]
+
+// Static exchange evaluation: the material the side to move wins or loses
+// on the target square if both sides keep recapturing with their least
+// valuable piece, each free to stop when going on would cost it
+int see(const Board& board, const Move& move);
+
+// Hands out a node's moves one at a time in stages, generating and scoring
+// each group only when the previous one is used up. Most nodes cut off on
+// the first few moves and never pay for the quiets.
+class MovePicker {
+private:
+    enum Stage {
+        TT_MOVE, CAPTURE_INIT, GOOD_CAPTURES, KILLER_1, KILLER_2, COUNTERMOVE,
+        QUIET_INIT, QUIETS, BAD_CAPTURES,
+        QS_TT_MOVE, QS_CAPTURE_INIT, QS_CAPTURES,
+        EVASION_INIT, EVASIONS,
+        DONE
+    };
+    
+    const Board& board;
+    Move tt_move;
+    Move killers[2];
+    Move countermove;
+    const ButterflyHistory* butterfly = nullptr;
+    const PieceToHistory* continuation[2] = {nullptr, nullptr};
+    
+    int stage;
+    bool evasions = false;
+    MoveList moves;
+    MoveList bad_captures;
+    int current = 0;
+    
+    void score_captures();
+    void score_quiets();
+    void score_evasions();
+    Move select_best();
+    bool is_special(const Move& move) const;
+    
+public:
+    // Main search: every legal move. A continuation table is null when
+    // there is no real move that many plies back
+    MovePicker(const Board& board, Move tt_move, const Move* killers, Move countermove,
+               const ButterflyHistory* butterfly, const PieceToHistory* continuation[2]);
+    // Quiescence: captures and promotions, or every evasion when in check
+    MovePicker(const Board& board, Move tt_move, bool in_check);
+    
+    // The next move to search, or a null move once all are out
+    Move next_move();
+};
+
+#endif
@@ -2,64 +2,209 @@
 #include "board.h"
 #include <algorithm>
 
-// Precomputed move tables
-u64 knight_moves[64];
-u64 king_moves[64];
-u64 pawn_attacks[2][64];
+// Attacks of a piece stepping once along each of the given deltas
+static constexpr u64 step_attacks(int square, const int (&deltas)[8][2]) {
+    u64 attacks = 0;
+    for (int i = 0; i < 8; i++) {
+        int rr = rank_of(square) + deltas[i][0], ff = file_of(square) + deltas[i][1];
+        if (rr >= 0 && rr < 8 && ff >= 0 && ff < 8)
+            attacks |= 1ULL << (rr * 8 + ff);
+    }
+    return attacks;
+}
 
-void init_move_tables() {
-    // Knight moves
-    int knight_dx[8] = {1, 2, 2, 1, -1, -2, -2, -1};
-    int knight_dy[8] = {2, 1, -1, -2, -2, -1, 1, 2};
-    
+static constexpr int KNIGHT_DELTAS[8][2] = {{2,1}, {1,2}, {-1,2}, {-2,1}, {-2,-1}, {-1,-2}, {1,-2}, {2,-1}};
+static constexpr int KING_DELTAS[8][2] = {{0,1}, {1,1}, {1,0}, {1,-1}, {0,-1}, {-1,-1}, {-1,0}, {-1,1}};
+
+// Precomputed move tables, built at compile time
+constexpr std::array<u64, 64> knight_moves = [] {
+    std::array<u64, 64> table{};
+    for (int sq = 0; sq < 64; sq++) table[sq] = step_attacks(sq, KNIGHT_DELTAS);
+    return table;
+}();
+
+constexpr std::array<u64, 64> king_moves = [] {
+    std::array<u64, 64> table{};
+    for (int sq = 0; sq < 64; sq++) table[sq] = step_attacks(sq, KING_DELTAS);
+    return table;
+}();
+
+constexpr std::array<std::array<u64, 64>, 2> pawn_attacks = [] {
+    std::array<std::array<u64, 64>, 2> table{};
     for (int sq = 0; sq < 64; sq++) {
         int r = rank_of(sq), f = file_of(sq);
-        knight_moves[sq] = 0;
-        
-        for (int i = 0; i < 8; i++) {
-            int rr = r + knight_dy[i], ff = f + knight_dx[i];
-            if (rr >= 0 && rr < 8 && ff >= 0 && ff < 8)
-                knight_moves[sq] |= 1ULL << (rr * 8 + ff);
+        if (r < 7) {
+            if (f > 0) table[WHITE][sq] |= 1ULL << (sq + 7);
+            if (f < 7) table[WHITE][sq] |= 1ULL << (sq + 9);
+        }
+        if (r > 0) {
+            if (f > 0) table[BLACK][sq] |= 1ULL << (sq - 9);
+            if (f < 7) table[BLACK][sq] |= 1ULL << (sq - 7);
+        }
+    }
+    return table;
+}();
+
+// Squares from the given square (exclusive) to the board edge in one direction
+static constexpr u64 ray(int square, int dr, int df) {
+    u64 squares = 0;
+    for (int rr = rank_of(square) + dr, ff = file_of(square) + df;
+         rr >= 0 && rr < 8 && ff >= 0 && ff < 8; rr += dr, ff += df) {
+        squares |= 1ULL << (rr * 8 + ff);
+    }
+    return squares;
+}
+
+constexpr std::array<std::array<u64, 64>, 64> between_squares = [] {
+    std::array<std::array<u64, 64>, 64> table{};
+    for (int s1 = 0; s1 < 64; s1++) {
+        for (int d = 0; d < 8; d++) {
+            u64 seen = 0;
+            int dr = KING_DELTAS[d][0], df = KING_DELTAS[d][1];
+            for (int rr = rank_of(s1) + dr, ff = file_of(s1) + df;
+                 rr >= 0 && rr < 8 && ff >= 0 && ff < 8; rr += dr, ff += df) {
+                table[s1][rr * 8 + ff] = seen;
+                seen |= 1ULL << (rr * 8 + ff);
+            }
         }
     }
+    return table;
+}();
+
+constexpr std::array<std::array<u64, 64>, 64> line_through = [] {
+    std::array<std::array<u64, 64>, 64> table{};
+    for (int s1 = 0; s1 < 64; s1++) {
+        for (int d = 0; d < 8; d++) {
+            int dr = KING_DELTAS[d][0], df = KING_DELTAS[d][1];
+            u64 line = ray(s1, dr, df) | ray(s1, -dr, -df) | (1ULL << s1);
+            for (int rr = rank_of(s1) + dr, ff = file_of(s1) + df;
+                 rr >= 0 && rr < 8 && ff >= 0 && ff < 8; rr += dr, ff += df) {
+                table[s1][rr * 8 + ff] = line;
+            }
+        }
+    }
+    return table;
+}();
+
+// Magic bitboard tables
+u64 bishop_attack_table[5248];
+u64 rook_attack_table[102400];
+
+static constexpr u64 BISHOP_MAGIC_NUMBERS[64] = {
+    0x0908010420840301ULL, 0x0228084104202000ULL, 0x04640142020a0005ULL, 0x00044c0980000012ULL,
+    0x00040420e0010000ULL, 0x1800903008000802ULL, 0x040c0a0150480040ULL, 0x2402104808180840ULL,
+    0x2e00602004811240ULL, 0x8002041080910100ULL, 0x0001100c00624c20ULL, 0x1800044043800001ULL,
+    0x0009820210a20110ULL, 0x010003041a401001ULL, 0x0058010802022000ULL, 0x0040050c00840400ULL,
+    0x00090040100400c0ULL, 0x8008110208280081ULL, 0x001000280180208eULL, 0x0404410801410020ULL,
+    0x0401002820084000ULL, 0x0401001480414042ULL, 0x040a008400824820ULL, 0x4600200084042244ULL,
+    0x006010502004c100ULL, 0x0121081144101440ULL, 0x4000880230005010ULL, 0x0040040000410020ULL,
+    0x8000404004010040ULL, 0x400082000022102aULL, 0x0801091244040100ULL, 0x0040608000420800ULL,
+    0x0050040509210802ULL, 0x0000d01004040400ULL, 0x0004003800940040ULL, 0x00404018a0020200ULL,
+    0x3040008021220020ULL, 0x3000809100820100ULL, 0xa8102081002a0100ULL, 0x000a0a0608112090ULL,
+    0x04c2020242402000ULL, 0x0082010420000200ULL, 0x1300202828009000ULL, 0x0004042018002900ULL,
+    0x0010010202000420ULL, 0x01c0008081004084ULL, 0x0008b00102150440ULL, 0x210c540086084620ULL,
+    0x100c0c210410c003ULL, 0x0102004402084004ULL, 0x000102010088842cULL, 0x0020041084040c00ULL,
+    0x8000101202020000ULL, 0x0410104230011100ULL, 0x0410100200842008ULL, 0x0028420800411000ULL,
+    0x2400808808410408ULL, 0x0408003508021002ULL, 0x0010400084008880ULL, 0x4100000780840429ULL,
+    0x242060001002020aULL, 0x1841004005080080ULL, 0x0021202401882100ULL, 0x01a5010404140040ULL
+};
+
+static constexpr u64 ROOK_MAGIC_NUMBERS[64] = {
+    0x8080108000204000ULL, 0xc540004010082000ULL, 0x4080081000200080ULL, 0x0280080010008204ULL,
+    0x0600205004280200ULL, 0x02001021080c9a00ULL, 0x4200040802000081ULL, 0x2080004080042b00ULL,
+    0x000080002c904002ULL, 0x6049400c40201000ULL, 0x810880200080100bULL, 0x1000808008001000ULL,
+    0x0009000411000800ULL, 0xa001000300040008ULL, 0x0004006201042810ULL, 0x8512800040800100ULL,
+    0x0480024004402000ULL, 0x1050004040002006ULL, 0x0c00808020001000ULL, 0x84240b0010002100ULL,
+    0x0428808008020400ULL, 0x0000808002000400ULL, 0x1002808002000100ULL, 0x1800020001108044ULL,
+    0xc90081258008400aULL, 0x00c0400080802000ULL, 0x0420100080200085ULL, 0x1000104200220008ULL,
+    0x2500080080040080ULL, 0x1000040080020080ULL, 0x042200c200010428ULL, 0x2000086200040091ULL,
+    0x0100804000800028ULL, 0x0030004000402000ULL, 0x0059002001004014ULL, 0x4c18001001010020ULL,
+    0x1022001006002008ULL, 0x2000800200800400ULL, 0x0104890214002850ULL, 0x000809008a000054ULL,
+    0x4000804000208000ULL, 0x0020100020404008ULL, 0x2020200010008080ULL, 0xa040201042020008ULL,
+    0x0011080100910004ULL, 0x1845040002008080ULL, 0x5881001200050004ULL, 0x3000004400820001ULL,
+    0x0006258004c00080ULL, 0x00c0400080200080ULL, 0x000080e000100280ULL, 0x001a100209032100ULL,
+    0x1812040800110100ULL, 0x2580800200040080ULL, 0x1810820128100400ULL, 0x0000086100840200ULL,
+    0x8002004011002082ULL, 0x0102810420400019ULL, 0x04e0000b00102241ULL, 0x0020100005012009ULL,
+    0x0401000208001005ULL, 0x0809001204000803ULL, 0x1800288810020904ULL, 0x0043001080220449ULL
+};
+
+// Ray-walking attack generation, only used to build the magic tables
+static constexpr u64 sliding_attacks(int square, u64 occupancy, bool bishop) {
+    u64 attacks = 0;
+    int r = rank_of(square), f = file_of(square);
     
-    // King moves
-    int king_dx[8] = {1, 1, 0, -1, -1, -1, 0, 1};
-    int king_dy[8] = {0, 1, 1, 1, 0, -1, -1, -1};
+    const int dirsR[4][2] = {{1,0}, {-1,0}, {0,1}, {0,-1}};
+    const int dirsB[4][2] = {{1,1}, {1,-1}, {-1,1}, {-1,-1}};
     
-    for (int sq = 0; sq < 64; sq++) {
-        int r = rank_of(sq), f = file_of(sq);
-        king_moves[sq] = 0;
+    for (int d = 0; d < 4; d++) {
+        int dr = bishop ? dirsB[d][0] : dirsR[d][0];
+        int df = bishop ? dirsB[d][1] : dirsR[d][1];
         
-        for (int i = 0; i < 8; i++) {
-            int rr = r + king_dy[i], ff = f + king_dx[i];
-            if (rr >= 0 && rr < 8 && ff >= 0 && ff < 8)
-                king_moves[sq] |= 1ULL << (rr * 8 + ff);
+        int rr = r + dr, ff = f + df;
+        while (rr >= 0 && rr < 8 && ff >= 0 && ff < 8) {
+            int s = rr * 8 + ff;
+            attacks |= 1ULL << s;
+            if (occupancy & (1ULL << s)) break;
+            rr += dr;
+            ff += df;
         }
     }
-    
-    // Pawn attacks
+    return attacks;
+}
+
+// Squares whose occupancy affects the attack set: the rays without their final square
+static constexpr u64 relevant_occupancy_mask(int square, bool bishop) {
+    u64 edges = ((rank_bb(0) | rank_bb(7)) & ~rank_bb(rank_of(square))) |
+                ((FILE_A_BB | FILE_H_BB) & ~file_bb(file_of(square)));
+    return sliding_attacks(square, 0ULL, bishop) & ~edges;
+}
+
+static constexpr int count_bits(u64 b) {
+    int count = 0;
+    for (; b; b &= b - 1) count++;
+    return count;
+}
+
+static constexpr std::array<Magic, 64> make_magics(const u64 (&magic_numbers)[64], bool bishop) {
+    std::array<Magic, 64> magics{};
+    int offset = 0;
     for (int sq = 0; sq < 64; sq++) {
-        pawn_attacks[WHITE][sq] = 0;
-        pawn_attacks[BLACK][sq] = 0;
-        
-        int r = rank_of(sq), f = file_of(sq);
-        
-        // White pawn attacks
-        if (r < 7) {
-            if (f > 0) pawn_attacks[WHITE][sq] |= 1ULL << (sq + 7);
-            if (f < 7) pawn_attacks[WHITE][sq] |= 1ULL << (sq + 9);
-        }
+        Magic& m = magics[sq];
+        m.mask = relevant_occupancy_mask(sq, bishop);
+        m.magic = magic_numbers[sq];
+        m.shift = 64 - count_bits(m.mask);
+        m.offset = offset;
+        offset += 1 << count_bits(m.mask);
+    }
+    return magics;
+}
+
+constexpr std::array<Magic, 64> bishop_magics = make_magics(BISHOP_MAGIC_NUMBERS, true);
+constexpr std::array<Magic, 64> rook_magics = make_magics(ROOK_MAGIC_NUMBERS, false);
+
+// The attack tables themselves (over 100k entries) are beyond what compilers
+// will evaluate as constant expressions by default, so they are filled here
+static void init_slider_table(const std::array<Magic, 64>& magics, u64* table, bool bishop) {
+    for (int sq = 0; sq < 64; sq++) {
+        const Magic& m = magics[sq];
         
-        // Black pawn attacks
-        if (r > 0) {
-            if (f > 0) pawn_attacks[BLACK][sq] |= 1ULL << (sq - 9);
-            if (f < 7) pawn_attacks[BLACK][sq] |= 1ULL << (sq - 7);
-        }
+        // Carry-Rippler enumeration of every subset of the mask
+        u64 occupancy = 0;
+        do {
+            table[magic_index(m, occupancy)] = sliding_attacks(sq, occupancy, bishop);
+            occupancy = (occupancy - m.mask) & m.mask;
+        } while (occupancy);
     }
 }
 
+void init_move_tables() {
+    init_slider_table(bishop_magics, bishop_attack_table, true);
+    init_slider_table(rook_magics, rook_attack_table, false);
+}
+
 std::string Move::to_uci() const {
+    if (is_null()) return "0000";
+    
     auto sq_name = [](int s) {
         std::string r;
         r.push_back('a' + file_of(s));
@@ -67,466 +212,410 @@ std::string Move::to_uci() const {
         return r;
     };
     
-    std::string s = sq_name(from) + sq_name(to);
-    if (promotion) {
-        char pc = 'q';
-        if (promotion == WHITE_ROOK || promotion == BLACK_ROOK) pc = 'r';
-        else if (promotion == WHITE_KNIGHT || promotion == BLACK_KNIGHT) pc = 'n';
-        else if (promotion == WHITE_BISHOP || promotion == BLACK_BISHOP) pc = 'b';
-        s.push_back(pc);
+    std::string s = sq_name(from()) + sq_name(to());
+    if (is_promotion()) {
+        s.push_back("nbrq"[flag() & 3]);
     }
     return s;
 }
 
-u64 get_slider_attacks(int square, const Board& board, bool bishop, bool rook) {
-    u64 attacks = 0;
-    int r = rank_of(square), f = file_of(square);
+void MoveGenerator::generate_moves(const Board& board, MoveList& moves) {
+    generate(board, moves, GEN_ALL);
+}
+
+void MoveGenerator::generate_captures(const Board& board, MoveList& moves) {
+    generate(board, moves, GEN_CAPTURES);
+}
+
+void MoveGenerator::generate_quiets(const Board& board, MoveList& moves) {
+    generate(board, moves, GEN_QUIETS);
+}
+
+void MoveGenerator::generate(const Board& board, MoveList& moves, GenType type) {
+    if (board.side_to_move == WHITE) generate<WHITE>(board, moves, type);
+    else generate<BLACK>(board, moves, type);
+}
+
+template <Color Us>
+void MoveGenerator::generate(const Board& board, MoveList& moves, GenType type) {
+    constexpr Color Them = (Us == WHITE) ? BLACK : WHITE;
+    constexpr int King = (Us == WHITE) ? WHITE_KING : BLACK_KING;
+    u64 occ = board.occupancies[2];
     
-    const int dirsR[4][2] = {{1,0}, {-1,0}, {0,1}, {0,-1}};
-    const int dirsB[4][2] = {{1,1}, {1,-1}, {-1,1}, {-1,-1}};
+    GenState state;
+    state.king_square = bit_scan_forward(board.pieces[King]);
+    state.pinned = pinned_pieces<Us>(board, state.king_square);
+    
+    // Squares the pieces may move to for this kind of generation
+    if (type == GEN_CAPTURES) state.targets = board.occupancies[Them];
+    else if (type == GEN_QUIETS) state.targets = ~occ;
+    else state.targets = ~board.occupancies[Us];
+    u64 king_targets = state.targets;
     
-    int dir_count = (bishop && rook) ? 8 : (bishop ? 4 : 4);
+    u64 checkers = board.attackers_to(state.king_square, occ) & board.occupancies[Them];
+    state.check_mask = ~0ULL;
+    if (checkers) {
+        // Capture the checker or block the line to the king
+        state.check_mask = between_squares[state.king_square][bit_scan_forward(checkers)] | checkers;
+        state.targets &= state.check_mask;
+    }
+    
+    moves.clear();
+    
+    // In double check only the king may move
+    if (!(checkers & (checkers - 1))) {
+        generate_pawn_moves<Us>(board, moves, type, state);
+        generate_knight_moves<Us>(board, moves, state);
+        generate_bishop_moves<Us>(board, moves, state);
+        generate_rook_moves<Us>(board, moves, state);
+        generate_queen_moves<Us>(board, moves, state);
+    }
+    generate_king_moves<Us>(board, moves, king_targets, state);
+    if (type != GEN_CAPTURES && !checkers) {
+        generate_castling_moves<Us>(board, moves);
+    }
+}
+
+template <Color Us>
+u64 MoveGenerator::pinned_pieces(const Board& board, int king_square) {
+    constexpr int TheirQueen = (Us == WHITE) ? BLACK_QUEEN : WHITE_QUEEN;
+    constexpr int TheirRook = (Us == WHITE) ? BLACK_ROOK : WHITE_ROOK;
+    constexpr int TheirBishop = (Us == WHITE) ? BLACK_BISHOP : WHITE_BISHOP;
+    u64 occ = board.occupancies[2];
+    u64 their_rooks = board.pieces[TheirRook] | board.pieces[TheirQueen];
+    u64 their_bishops = board.pieces[TheirBishop] | board.pieces[TheirQueen];
+    
+    // Enemy sliders that would see the king on an empty board
+    u64 snipers = (rook_attacks(king_square, 0ULL) & their_rooks) |
+                  (bishop_attacks(king_square, 0ULL) & their_bishops);
+    
+    u64 pinned = 0ULL;
+    while (snipers) {
+        int sq = bit_scan_forward(snipers);
+        snipers &= snipers - 1;
+        u64 blockers = between_squares[king_square][sq] & occ;
+        if (blockers && !(blockers & (blockers - 1))) {
+            pinned |= blockers & board.occupancies[Us];
+        }
+    }
+    return pinned;
+}
+
+bool MoveGenerator::is_legal(const Board& board, const Move& move) {
+    if (board.side_to_move == WHITE) return is_legal<WHITE>(board, move);
+    return is_legal<BLACK>(board, move);
+}
+
+template <Color Us>
+bool MoveGenerator::is_legal(const Board& board, const Move& move) {
+    constexpr Color Them = (Us == WHITE) ? BLACK : WHITE;
+    constexpr int Pawn = (Us == WHITE) ? WHITE_PAWN : BLACK_PAWN;
+    constexpr int King = (Us == WHITE) ? WHITE_KING : BLACK_KING;
+    constexpr int Up = (Us == WHITE) ? 8 : -8;
+    
+    const int from = move.from();
+    const int to = move.to();
+    const int piece = board.piece_on(from);
+    const u64 to_bb = 1ULL << to;
+    const u64 occ = board.occupancies[2];
+    
+    if (move.is_null() || piece == EMPTY || piece_color(piece) != Us) return false;
+    if (board.occupancies[Us] & to_bb) return false;
+    if (move.flag() == 3 || move.flag() > MF_PROMO_QUEEN) return false;
     
-    for (int d = 0; d < dir_count; d++) {
-        int dr, df;
-        if (d < 4) {
-            if (bishop) { dr = dirsB[d][0]; df = dirsB[d][1]; }
-            else { dr = dirsR[d][0]; df = dirsR[d][1]; }
-        } else {
-            dr = dirsR[d-4][0]; df = dirsR[d-4][1];
+    // Castling and en passant are rare enough to check against the generator
+    if (move.is_castle() || move.is_enpassant()) {
+        MoveList moves;
+        generate<Us>(board, moves, GEN_ALL);
+        for (const Move& legal : moves) {
+            if (legal == move) return true;
         }
+        return false;
+    }
+    
+    // Pseudo-legality: the piece can reach the square with this flag
+    if (piece == Pawn) {
+        const bool last_rank = rank_of(to) == (Us == WHITE ? 7 : 0);
+        if (last_rank != move.is_promotion() || (!last_rank && move.flag() != MF_NORMAL)) return false;
         
-        int rr = r + dr, ff = f + df;
-        while (rr >= 0 && rr < 8 && ff >= 0 && ff < 8) {
-            int s = rr * 8 + ff;
-            attacks |= 1ULL << s;
-            if (board.occupancies[2] & (1ULL << s)) break;
-            rr += dr;
-            ff += df;
+        const bool capture = pawn_attacks[Us][from] & board.occupancies[Them] & to_bb;
+        const bool push = to == from + Up && !(occ & to_bb);
+        const bool double_push = to == from + 2 * Up && rank_of(from) == (Us == WHITE ? 1 : 6)
+                              && !(occ & to_bb) && !(occ & (1ULL << (from + Up)));
+        if (!capture && !push && !double_push) return false;
+    } else {
+        if (move.flag() != MF_NORMAL) return false;
+        
+        u64 reach;
+        switch (piece - Pawn) {
+            case 1:  reach = knight_moves[from]; break;
+            case 2:  reach = bishop_attacks(from, occ); break;
+            case 3:  reach = rook_attacks(from, occ); break;
+            case 4:  reach = queen_attacks(from, occ); break;
+            default: reach = king_moves[from]; break;
         }
+        if (!(reach & to_bb)) return false;
     }
-    return attacks;
+    
+    // Legality: the king may not step into an attack, anything else must
+    // answer a check and keep to its pin line
+    const int king_square = bit_scan_forward(board.pieces[King]);
+    if (piece == King) {
+        return !(board.attackers_to(to, occ ^ (1ULL << from)) & board.occupancies[Them]);
+    }
+    
+    u64 checkers = board.attackers_to(king_square, occ) & board.occupancies[Them];
+    if (checkers) {
+        if (checkers & (checkers - 1)) return false;
+        if (!((between_squares[king_square][bit_scan_forward(checkers)] | checkers) & to_bb)) return false;
+    }
+    
+    return !(pinned_pieces<Us>(board, king_square) & (1ULL << from))
+        || (line_through[king_square][from] & to_bb);
 }
 
-void MoveGenerator::generate_moves(const Board& board, std::vector<Move>& moves) {
-    moves.clear();
-    generate_pawn_moves(board, moves);
-    generate_knight_moves(board, moves);
-    generate_bishop_moves(board, moves);
-    generate_rook_moves(board, moves);
-    generate_queen_moves(board, moves);
-    generate_king_moves(board, moves);
-    generate_castling_moves(board, moves);
+// Shift a whole bitboard by a pawn step, dropping squares that would wrap
+// around the board edge
+template <int Offset>
+static inline u64 shift(u64 b) {
+    return Offset == 8  ? b << 8 :
+           Offset == -8 ? b >> 8 :
+           Offset == 7  ? (b & ~FILE_A_BB) << 7 :
+           Offset == 9  ? (b & ~FILE_H_BB) << 9 :
+           Offset == -9 ? (b & ~FILE_A_BB) >> 9 :
+           Offset == -7 ? (b & ~FILE_H_BB) >> 7 : 0ULL;
 }
 
-void MoveGenerator::generate_captures(const Board& board, std::vector<Move>& moves) {
-    generate_moves(board, moves);
-    // Filter to only captures and promotions
-    moves.erase(std::remove_if(moves.begin(), moves.end(), 
-        [](const Move& m) { return !m.captured && !m.promotion; }), 
-        moves.end());
+// Emit one move per target square of a pawn shift by Offset. A pinned pawn
+// must stay on the line through its king.
+template <int Offset>
+static inline void add_pawn_moves(MoveList& moves, u64 targets, const MoveGenerator::GenState& state) {
+    while (targets) {
+        int to = bit_scan_forward(targets);
+        targets &= targets - 1;
+        int from = to - Offset;
+        if ((state.pinned & (1ULL << from)) && !(line_through[state.king_square][from] & (1ULL << to))) continue;
+        moves.push_back(Move(from, to));
+    }
 }
 
-bool MoveGenerator::is_move_legal(Board& board, const Move& move) {
-    Board::UndoInfo undo = board.make_move(move);
-    bool legal = !board.in_check((Color)(!board.side_to_move));
-    board.undo_move(undo);
-    return legal;
+template <int Offset>
+static inline void add_promotions(MoveList& moves, u64 targets, const MoveGenerator::GenState& state) {
+    while (targets) {
+        int to = bit_scan_forward(targets);
+        targets &= targets - 1;
+        int from = to - Offset;
+        if ((state.pinned & (1ULL << from)) && !(line_through[state.king_square][from] & (1ULL << to))) continue;
+        for (int flag : {MF_PROMO_QUEEN, MF_PROMO_ROOK, MF_PROMO_BISHOP, MF_PROMO_KNIGHT}) {
+            moves.push_back(Move(from, to, flag));
+        }
+    }
 }
 
-void MoveGenerator::generate_pawn_moves(const Board& board, std::vector<Move>& moves) {
-    Color stm = board.side_to_move;
-    u64 pawns = board.pieces[stm == WHITE ? WHITE_PAWN : BLACK_PAWN];
+template <Color Us>
+void MoveGenerator::generate_pawn_moves(const Board& board, MoveList& moves, GenType type, const GenState& state) {
+    constexpr Color Them = (Us == WHITE) ? BLACK : WHITE;
+    constexpr int Pawn = (Us == WHITE) ? WHITE_PAWN : BLACK_PAWN;
+    constexpr int Up = (Us == WHITE) ? 8 : -8;
+    constexpr int UpLeft = (Us == WHITE) ? 7 : -9;  // Towards the a-file
+    constexpr int UpRight = (Us == WHITE) ? 9 : -7; // Towards the h-file
+    const u64 promo_rank = rank_bb(Us == WHITE ? 6 : 1);
+    const u64 push_rank = rank_bb(Us == WHITE ? 2 : 5); // Reached by a first single push
     
-    while (pawns) {
-        int sq = bit_scan_forward(pawns);
-        pawns &= pawns - 1;
-        int r = rank_of(sq), f = file_of(sq);
-        
-        if (stm == WHITE) {
-            // Single push
-            int to = sq + 8;
-            if (r < 7 && !(board.occupancies[2] & (1ULL << to))) {
-                if (r == 6) { // Promotion
-                    for (int promo : {WHITE_QUEEN, WHITE_ROOK, WHITE_BISHOP, WHITE_KNIGHT}) {
-                        moves.push_back({sq, to, WHITE_PAWN, 0, promo, false, false});
-                    }
-                } else {
-                    moves.push_back({sq, to, WHITE_PAWN, 0, 0, false, false});
-                    // Double push from rank 2
-                    if (r == 1) {
-                        int to2 = sq + 16;
-                        if (!(board.occupancies[2] & (1ULL << to2))) {
-                            moves.push_back({sq, to2, WHITE_PAWN, 0, 0, false, false});
-                        }
-                    }
-                }
-            }
-            
-            // Captures
-            if (f > 0) {
-                int toL = sq + 7;
-                if (r < 7) {
-                    if (board.occupancies[BLACK] & (1ULL << toL)) {
-                        int cap = 0;
-                        for (int p = BLACK_PAWN; p <= BLACK_KING; p++) {
-                            if (board.pieces[p] & (1ULL << toL)) {
-                                cap = p;
-                                break;
-                            }
-                        }
-                        if (r == 6) {
-                            for (int promo : {WHITE_QUEEN, WHITE_ROOK, WHITE_BISHOP, WHITE_KNIGHT}) {
-                                moves.push_back({sq, toL, WHITE_PAWN, cap, promo, false, false});
-                            }
-                        } else {
-                            moves.push_back({sq, toL, WHITE_PAWN, cap, 0, false, false});
-                        }
-                    }
-                    if (board.enpassant_square == toL) {
-                        moves.push_back({sq, toL, WHITE_PAWN, BLACK_PAWN, 0, true, false});
-                    }
-                }
-            }
-            
-            if (f < 7) {
-                int toR = sq + 9;
-                if (r < 7) {
-                    if (board.occupancies[BLACK] & (1ULL << toR)) {
-                        int cap = 0;
-                        for (int p = BLACK_PAWN; p <= BLACK_KING; p++) {
-                            if (board.pieces[p] & (1ULL << toR)) {
-                                cap = p;
-                                break;
-                            }
-                        }
-                        if (r == 6) {
-                            for (int promo : {WHITE_QUEEN, WHITE_ROOK, WHITE_BISHOP, WHITE_KNIGHT}) {
-                                moves.push_back({sq, toR, WHITE_PAWN, cap, promo, false, false});
-                            }
-                        } else {
-                            moves.push_back({sq, toR, WHITE_PAWN, cap, 0, false, false});
-                        }
-                    }
-                    if (board.enpassant_square == toR) {
-                        moves.push_back({sq, toR, WHITE_PAWN, BLACK_PAWN, 0, true, false});
-                    }
-                }
-            }
-        } else { // BLACK pawns
-            // Single push
-            int to = sq - 8;
-            if (r > 0 && !(board.occupancies[2] & (1ULL << to))) {
-                if (r == 1) { // Promotion
-                    for (int promo : {BLACK_QUEEN, BLACK_ROOK, BLACK_BISHOP, BLACK_KNIGHT}) {
-                        moves.push_back({sq, to, BLACK_PAWN, 0, promo, false, false});
-                    }
-                } else {
-                    moves.push_back({sq, to, BLACK_PAWN, 0, 0, false, false});
-                    // Double push from rank 7
-                    if (r == 6) {
-                        int to2 = sq - 16;
-                        if (!(board.occupancies[2] & (1ULL << to2))) {
-                            moves.push_back({sq, to2, BLACK_PAWN, 0, 0, false, false});
-                        }
-                    }
-                }
-            }
-            
-            // Captures
-            if (f > 0) {
-                int toL = sq - 9;
-                if (r > 0) {
-                    if (board.occupancies[WHITE] & (1ULL << toL)) {
-                        int cap = 0;
-                        for (int p = WHITE_PAWN; p <= WHITE_KING; p++) {
-                            if (board.pieces[p] & (1ULL << toL)) {
-                                cap = p;
-                                break;
-                            }
-                        }
-                        if (r == 1) {
-                            for (int promo : {BLACK_QUEEN, BLACK_ROOK, BLACK_BISHOP, BLACK_KNIGHT}) {
-                                moves.push_back({sq, toL, BLACK_PAWN, cap, promo, false, false});
-                            }
-                        } else {
-                            moves.push_back({sq, toL, BLACK_PAWN, cap, 0, false, false});
-                        }
-                    }
-                    if (board.enpassant_square == toL) {
-                        moves.push_back({sq, toL, BLACK_PAWN, WHITE_PAWN, 0, true, false});
-                    }
-                }
-            }
-            
-            if (f < 7) {
-                int toR = sq - 7;
-                if (r > 0) {
-                    if (board.occupancies[WHITE] & (1ULL << toR)) {
-                        int cap = 0;
-                        for (int p = WHITE_PAWN; p <= WHITE_KING; p++) {
-                            if (board.pieces[p] & (1ULL << toR)) {
-                                cap = p;
-                                break;
-                            }
-                        }
-                        if (r == 1) {
-                            for (int promo : {BLACK_QUEEN, BLACK_ROOK, BLACK_BISHOP, BLACK_KNIGHT}) {
-                                moves.push_back({sq, toR, BLACK_PAWN, cap, promo, false, false});
-                            }
-                        } else {
-                            moves.push_back({sq, toR, BLACK_PAWN, cap, 0, false, false});
-                        }
-                    }
-                    if (board.enpassant_square == toR) {
-                        moves.push_back({sq, toR, BLACK_PAWN, WHITE_PAWN, 0, true, false});
-                    }
-                }
+    u64 pawns = board.pieces[Pawn];
+    u64 empty = ~board.occupancies[2];
+    u64 enemies = board.occupancies[Them] & state.check_mask;
+    u64 promoting = pawns & promo_rank;
+    u64 others = pawns & ~promo_rank;
+    
+    // Single and double pushes are quiet
+    if (type != GEN_CAPTURES) {
+        u64 single = shift<Up>(others) & empty;
+        u64 twice = shift<Up>(single & push_rank) & empty;
+        add_pawn_moves<Up>(moves, single & state.check_mask, state);
+        add_pawn_moves<Up + Up>(moves, twice & state.check_mask, state);
+    }
+    
+    if (type == GEN_QUIETS) return;
+    
+    // Promotions, pushes and captures alike, go with the captures
+    if (promoting) {
+        add_promotions<Up>(moves, shift<Up>(promoting) & empty & state.check_mask, state);
+        add_promotions<UpLeft>(moves, shift<UpLeft>(promoting) & enemies, state);
+        add_promotions<UpRight>(moves, shift<UpRight>(promoting) & enemies, state);
+    }
+    
+    add_pawn_moves<UpLeft>(moves, shift<UpLeft>(others) & enemies, state);
+    add_pawn_moves<UpRight>(moves, shift<UpRight>(others) & enemies, state);
+    
+    // En passant removes two pieces from one line, so test the resulting
+    // position directly rather than relying on the pin and check masks
+    if (board.enpassant_square != SQ_NONE) {
+        int ep = board.enpassant_square;
+        u64 captured = 1ULL << (ep - Up);
+        u64 attackers = others & pawn_attacks[Them][ep];
+        while (attackers) {
+            int from = bit_scan_forward(attackers);
+            attackers &= attackers - 1;
+            u64 occ_after = (board.occupancies[2] ^ (1ULL << from) ^ captured) | (1ULL << ep);
+            if (!(board.attackers_to(state.king_square, occ_after) & board.occupancies[Them] & ~captured)) {
+                moves.push_back(Move(from, ep, MF_ENPASSANT));
             }
         }
     }
 }
 
-void MoveGenerator::generate_knight_moves(const Board& board, std::vector<Move>& moves) {
-    Color stm = board.side_to_move;
-    int knight_piece = (stm == WHITE) ? WHITE_KNIGHT : BLACK_KNIGHT;
-    u64 knights = board.pieces[knight_piece];
+template <Color Us>
+void MoveGenerator::generate_knight_moves(const Board& board, MoveList& moves, const GenState& state) {
+    constexpr int Knight = (Us == WHITE) ? WHITE_KNIGHT : BLACK_KNIGHT;
+    
+    // A pinned knight can never stay on the pin line
+    u64 knights = board.pieces[Knight] & ~state.pinned;
     
     while (knights) {
         int sq = bit_scan_forward(knights);
         knights &= knights - 1;
-        u64 targets = knight_moves[sq] & ~board.occupancies[stm];
+        u64 targets = knight_moves[sq] & state.targets;
         
         while (targets) {
             int to = bit_scan_forward(targets);
             targets &= targets - 1;
-            
-            int cap = 0;
-            Color opp = (Color)(!stm);
-            for (int p = (opp == WHITE ? WHITE_PAWN : BLACK_PAWN); 
-                 p <= (opp == WHITE ? WHITE_KING : BLACK_KING); p++) {
-                if (board.pieces[p] & (1ULL << to)) {
-                    cap = p;
-                    break;
-                }
-            }
-            moves.push_back({sq, to, knight_piece, cap, 0, false, false});
+            moves.push_back(Move(sq, to));
         }
     }
 }
 
-void MoveGenerator::generate_bishop_moves(const Board& board, std::vector<Move>& moves) {
-    Color stm = board.side_to_move;
-    int bishop_piece = (stm == WHITE) ? WHITE_BISHOP : BLACK_BISHOP;
-    u64 bishops = board.pieces[bishop_piece];
+template <Color Us>
+void MoveGenerator::generate_bishop_moves(const Board& board, MoveList& moves, const GenState& state) {
+    constexpr int Bishop = (Us == WHITE) ? WHITE_BISHOP : BLACK_BISHOP;
+    u64 bishops = board.pieces[Bishop];
     
     while (bishops) {
         int sq = bit_scan_forward(bishops);
         bishops &= bishops - 1;
-        u64 attacks = get_slider_attacks(sq, board, true, false);
-        u64 targets = attacks & ~board.occupancies[stm];
+        u64 attacks = bishop_attacks(sq, board.occupancies[2]);
+        u64 targets = attacks & state.targets;
+        if (state.pinned & (1ULL << sq)) targets &= line_through[state.king_square][sq];
         
         while (targets) {
             int to = bit_scan_forward(targets);
             targets &= targets - 1;
-            
-            int cap = 0;
-            Color opp = (Color)(!stm);
-            for (int p = (opp == WHITE ? WHITE_PAWN : BLACK_PAWN); 
-                 p <= (opp == WHITE ? WHITE_KING : BLACK_KING); p++) {
-                if (board.pieces[p] & (1ULL << to)) {
-                    cap = p;
-                    break;
-                }
-            }
-            moves.push_back({sq, to, bishop_piece, cap, 0, false, false});
+            moves.push_back(Move(sq, to));
         }
     }
 }
 
-void MoveGenerator::generate_rook_moves(const Board& board, std::vector<Move>& moves) {
-    Color stm = board.side_to_move;
-    int rook_piece = (stm == WHITE) ? WHITE_ROOK : BLACK_ROOK;
-    u64 rooks = board.pieces[rook_piece];
+template <Color Us>
+void MoveGenerator::generate_rook_moves(const Board& board, MoveList& moves, const GenState& state) {
+    constexpr int Rook = (Us == WHITE) ? WHITE_ROOK : BLACK_ROOK;
+    u64 rooks = board.pieces[Rook];
     
     while (rooks) {
         int sq = bit_scan_forward(rooks);
         rooks &= rooks - 1;
-        u64 attacks = get_slider_attacks(sq, board, false, true);
-        u64 targets = attacks & ~board.occupancies[stm];
+        u64 attacks = rook_attacks(sq, board.occupancies[2]);
+        u64 targets = attacks & state.targets;
+        if (state.pinned & (1ULL << sq)) targets &= line_through[state.king_square][sq];
         
         while (targets) {
             int to = bit_scan_forward(targets);
             targets &= targets - 1;
-            
-            int cap = 0;
-            Color opp = (Color)(!stm);
-            for (int p = (opp == WHITE ? WHITE_PAWN : BLACK_PAWN); 
-                 p <= (opp == WHITE ? WHITE_KING : BLACK_KING); p++) {
-                if (board.pieces[p] & (1ULL << to)) {
-                    cap = p;
-                    break;
-                }
-            }
-            moves.push_back({sq, to, rook_piece, cap, 0, false, false});
+            moves.push_back(Move(sq, to));
         }
     }
 }
 
-void MoveGenerator::generate_queen_moves(const Board& board, std::vector<Move>& moves) {
-    Color stm = board.side_to_move;
-    int queen_piece = (stm == WHITE) ? WHITE_QUEEN : BLACK_QUEEN;
-    u64 queens = board.pieces[queen_piece];
+template <Color Us>
+void MoveGenerator::generate_queen_moves(const Board& board, MoveList& moves, const GenState& state) {
+    constexpr int Queen = (Us == WHITE) ? WHITE_QUEEN : BLACK_QUEEN;
+    u64 queens = board.pieces[Queen];
     
     while (queens) {
         int sq = bit_scan_forward(queens);
         queens &= queens - 1;
-        u64 attacks = get_slider_attacks(sq, board, true, true);
-        u64 targets = attacks & ~board.occupancies[stm];
+        u64 attacks = queen_attacks(sq, board.occupancies[2]);
+        u64 targets = attacks & state.targets;
+        if (state.pinned & (1ULL << sq)) targets &= line_through[state.king_square][sq];
         
         while (targets) {
             int to = bit_scan_forward(targets);
             targets &= targets - 1;
-            
-            int cap = 0;
-            Color opp = (Color)(!stm);
-            for (int p = (opp == WHITE ? WHITE_PAWN : BLACK_PAWN); 
-                 p <= (opp == WHITE ? WHITE_KING : BLACK_KING); p++) {
-                if (board.pieces[p] & (1ULL << to)) {
-                    cap = p;
-                    break;
-                }
-            }
-            moves.push_back({sq, to, queen_piece, cap, 0, false, false});
+            moves.push_back(Move(sq, to));
         }
     }
 }
 
-void MoveGenerator::generate_king_moves(const Board& board, std::vector<Move>& moves) {
-    Color stm = board.side_to_move;
-    int king_piece = (stm == WHITE) ? WHITE_KING : BLACK_KING;
-    u64 kings = board.pieces[king_piece];
+template <Color Us>
+void MoveGenerator::generate_king_moves(const Board& board, MoveList& moves, u64 target_mask, const GenState& state) {
+    constexpr Color Them = (Us == WHITE) ? BLACK : WHITE;
+    int sq = state.king_square;
+    u64 targets = king_moves[sq] & target_mask;
     
-    while (kings) {
-        int sq = bit_scan_forward(kings);
-        kings &= kings - 1;
-        u64 targets = king_moves[sq] & ~board.occupancies[stm];
-        
-        while (targets) {
-            int to = bit_scan_forward(targets);
-            targets &= targets - 1;
-            
-            int cap = 0;
-            Color opp = (Color)(!stm);
-            for (int p = (opp == WHITE ? WHITE_PAWN : BLACK_PAWN); 
-                 p <= (opp == WHITE ? WHITE_KING : BLACK_KING); p++) {
-                if (board.pieces[p] & (1ULL << to)) {
-                    cap = p;
-                    break;
-                }
-            }
-            moves.push_back({sq, to, king_piece, cap, 0, false, false});
+    // Look through the king so it cannot step back along a checking ray
+    u64 occ_without_king = board.occupancies[2] ^ (1ULL << sq);
+    
+    while (targets) {
+        int to = bit_scan_forward(targets);
+        targets &= targets - 1;
+        if (!(board.attackers_to(to, occ_without_king) & board.occupancies[Them])) {
+            moves.push_back(Move(sq, to));
         }
     }
 }
 
-void MoveGenerator::generate_castling_moves(const Board& board, std::vector<Move>& moves) {
-    Color stm = board.side_to_move;
-    
-    if (stm == WHITE) {
-        if ((board.castle_rights & 1) && // Kingside
-            !(board.occupancies[2] & (0x60ULL)) && // Squares between
-            board.pieces[WHITE_KING] & (1ULL << 60) && // King on e1
-            !board.is_square_attacked(60, BLACK) &&
-            !board.is_square_attacked(61, BLACK) &&
-            !board.is_square_attacked(62, BLACK)) {
-            moves.push_back({60, 62, WHITE_KING, 0, 0, false, true});
-        }
-        if ((board.castle_rights & 2) && // Queenside
-            !(board.occupancies[2] & (0xEULL)) && // Squares between
-            board.pieces[WHITE_KING] & (1ULL << 60) && // King on e1
-            !board.is_square_attacked(60, BLACK) &&
-            !board.is_square_attacked(59, BLACK) &&
-            !board.is_square_attacked(58, BLACK)) {
-            moves.push_back({60, 58, WHITE_KING, 0, 0, false, true});
-        }
-    } else {
-        if ((board.castle_rights & 4) && // Kingside
-            !(board.occupancies[2] & (0x6000000000000000ULL)) && // Squares between
-            board.pieces[BLACK_KING] & (1ULL << 4) && // King on e8
-            !board.is_square_attacked(4, WHITE) &&
-            !board.is_square_attacked(5, WHITE) &&
-            !board.is_square_attacked(6, WHITE)) {
-            moves.push_back({4, 6, BLACK_KING, 0, 0, false, true});
-        }
-        if ((board.castle_rights & 8) && // Queenside
-            !(board.occupancies[2] & (0xE00000000000000ULL)) && // Squares between
-            board.pieces[BLACK_KING] & (1ULL << 4) && // King on e8
-            !board.is_square_attacked(4, WHITE) &&
-            !board.is_square_attacked(3, WHITE) &&
-            !board.is_square_attacked(2, WHITE)) {
-            moves.push_back({4, 2, BLACK_KING, 0, 0, false, true});
-        }
+template <Color Us>
+void MoveGenerator::generate_castling_moves(const Board& board, MoveList& moves) {
+    constexpr Color Them = (Us == WHITE) ? BLACK : WHITE;
+    constexpr int King = (Us == WHITE) ? WHITE_KING : BLACK_KING;
+    constexpr int KingSide = (Us == WHITE) ? 1 : 4;
+    constexpr int QueenSide = (Us == WHITE) ? 2 : 8;
+    constexpr int Home = (Us == WHITE) ? 0 : 56; // a1 or a8
+    
+    // Only called when not in check, so the king square itself is safe
+    if (!(board.pieces[King] & (1ULL << (Home + 4)))) return;
+    
+    if ((board.castle_rights & KingSide) &&
+        !(board.occupancies[2] & (0x60ULL << Home)) && // f and g files empty
+        !board.is_square_attacked(Home + 5, Them) &&
+        !board.is_square_attacked(Home + 6, Them)) {
+        moves.push_back(Move(Home + 4, Home + 6, MF_CASTLE));
+    }
+    if ((board.castle_rights & QueenSide) &&
+        !(board.occupancies[2] & (0xEULL << Home)) && // b, c and d files empty
+        !board.is_square_attacked(Home + 3, Them) &&
+        !board.is_square_attacked(Home + 2, Them)) {
+        moves.push_back(Move(Home + 4, Home + 2, MF_CASTLE));
     }
 }
 
 Move uci_to_move(const std::string& uci, const Board& board) {
-    if (uci.length() < 4) return {-1, -1, 0, 0, 0, false, false};
+    if (uci.length() < 4) return Move();
     
     int from = (uci[0] - 'a') + (uci[1] - '1') * 8;
     int to = (uci[2] - 'a') + (uci[3] - '1') * 8;
     
-    Move move;
-    move.from = from;
-    move.to = to;
-    move.promotion = 0;
-    move.isCastle = false;
-    move.isEnPassant = false;
-    move.captured = 0;
-    
-    // Find moving piece
-    for (int p = 1; p <= 12; p++) {
-        if (board.pieces[p] & (1ULL << from)) {
-            move.piece = p;
-            break;
-        }
-    }
-    
-    // Handle capture
-    for (int p = 1; p <= 12; p++) {
-        if (p != move.piece && (board.pieces[p] & (1ULL << to))) {
-            move.captured = p;
-            break;
-        }
-    }
+    int piece = board.piece_on(from);
+    int flag = MF_NORMAL;
     
     // Handle promotion
-    if (uci.size() == 5) {
+    if (uci.size() == 5 && (piece == WHITE_PAWN || piece == BLACK_PAWN)) {
         char pc = uci[4];
-        if (move.piece == WHITE_PAWN) {
-            if (pc == 'q') move.promotion = WHITE_QUEEN;
-            else if (pc == 'r') move.promotion = WHITE_ROOK;
-            else if (pc == 'n') move.promotion = WHITE_KNIGHT;
-            else if (pc == 'b') move.promotion = WHITE_BISHOP;
-        } else if (move.piece == BLACK_PAWN) {
-            if (pc == 'q') move.promotion = BLACK_QUEEN;
-            else if (pc == 'r') move.promotion = BLACK_ROOK;
-            else if (pc == 'n') move.promotion = BLACK_KNIGHT;
-            else if (pc == 'b') move.promotion = BLACK_BISHOP;
-        }
+        if (pc == 'q') flag = MF_PROMO_QUEEN;
+        else if (pc == 'r') flag = MF_PROMO_ROOK;
+        else if (pc == 'n') flag = MF_PROMO_KNIGHT;
+        else if (pc == 'b') flag = MF_PROMO_BISHOP;
     }
     
     // Handle castling
-    if ((move.piece == WHITE_KING || move.piece == BLACK_KING) && abs(from - to) == 2) {
-        move.isCastle = true;
+    if ((piece == WHITE_KING || piece == BLACK_KING) && abs(from - to) == 2) {
+        flag = MF_CASTLE;
     }
     
     // Handle en passant
-    if ((move.piece == WHITE_PAWN || move.piece == BLACK_PAWN) && 
-        file_of(from) != file_of(to) && move.captured == 0) {
-        move.isEnPassant = true;
-        move.captured = (move.piece == WHITE_PAWN) ? BLACK_PAWN : WHITE_PAWN;
+    if ((piece == WHITE_PAWN || piece == BLACK_PAWN) && 
+        file_of(from) != file_of(to) && board.piece_on(to) == EMPTY) {
+        flag = MF_ENPASSANT;
     }
     
-    return move;
+    return Move(from, to, flag);
 }
\ No newline at end of file
@@ -4,47 +4,152 @@
 #include "utils.h"
 #include <vector>
 
+#ifdef USE_PEXT
+#include <immintrin.h>
+#endif
+
 // Forward declaration
 class Board;
 
+// Special move kinds, stored in the top four bits of a Move
+enum MoveFlag {
+    MF_NORMAL = 0,
+    MF_ENPASSANT = 1,
+    MF_CASTLE = 2,
+    MF_PROMO_KNIGHT = 4, MF_PROMO_BISHOP = 5, MF_PROMO_ROOK = 6, MF_PROMO_QUEEN = 7
+};
+
+// Packed 16-bit move: from (bits 0-5), to (bits 6-11), flag (bits 12-15).
+// The moving and captured pieces are read from the board when needed.
 struct Move {
-    int from, to;
-    int piece;
-    int captured;
-    int promotion;
-    bool isEnPassant;
-    bool isCastle;
-    
-    bool operator==(const Move& other) const {
-        return from == other.from && to == other.to && 
-               piece == other.piece && promotion == other.promotion;
+    uint16_t data = 0;
+    
+    Move() = default;
+    Move(int from, int to, int flag = MF_NORMAL)
+        : data(static_cast<uint16_t>(from | (to << 6) | (flag << 12))) {}
+    
+    int from() const { return data & 63; }
+    int to() const { return (data >> 6) & 63; }
+    int flag() const { return data >> 12; }
+    int from_to() const { return data & 4095; } // Butterfly index
+    
+    bool is_null() const { return data == 0; }
+    bool is_enpassant() const { return flag() == MF_ENPASSANT; }
+    bool is_castle() const { return flag() == MF_CASTLE; }
+    bool is_promotion() const { return (flag() & 4) != 0; }
+    int promotion_piece(Color side) const {
+        return (side == WHITE ? WHITE_KNIGHT : BLACK_KNIGHT) + (flag() & 3);
     }
     
+    bool operator==(const Move& other) const { return data == other.data; }
+    bool operator!=(const Move& other) const { return data != other.data; }
+    
     std::string to_uci() const;
 };
 
-// Precomputed move tables
-extern u64 knight_moves[64];
-extern u64 king_moves[64];
-extern u64 pawn_attacks[2][64]; // [color][square]
+// Fixed-capacity move list, kept on the stack by its users
+struct MoveList {
+    static const int CAPACITY = 256;
+    
+    Move moves[CAPACITY];
+    int scores[CAPACITY]; // Ordering scores, filled by the searcher
+    int count = 0;
+    
+    void push_back(const Move& move) { moves[count++] = move; }
+    void clear() { count = 0; }
+    int size() const { return count; }
+    bool empty() const { return count == 0; }
+    
+    Move& operator[](int i) { return moves[i]; }
+    const Move& operator[](int i) const { return moves[i]; }
+    Move* begin() { return moves; }
+    Move* end() { return moves + count; }
+    const Move* begin() const { return moves; }
+    const Move* end() const { return moves + count; }
+};
+
+// Precomputed move tables, built at compile time
+extern const std::array<u64, 64> knight_moves;
+extern const std::array<u64, 64> king_moves;
+extern const std::array<std::array<u64, 64>, 2> pawn_attacks;      // [color][square]
+extern const std::array<std::array<u64, 64>, 64> between_squares;  // Squares strictly between two aligned squares
+extern const std::array<std::array<u64, 64>, 64> line_through;     // Full line through two aligned squares
+
+// Magic bitboard slider attacks
+struct Magic {
+    u64 mask;   // Relevant occupancy (board edges excluded)
+    u64 magic;
+    int shift;
+    int offset; // Start of this square's slice in the attack table
+};
+
+extern const std::array<Magic, 64> bishop_magics; // Built at compile time
+extern const std::array<Magic, 64> rook_magics;
+extern u64 bishop_attack_table[5248];             // Filled by init_move_tables()
+extern u64 rook_attack_table[102400];
 
 void init_move_tables();
-u64 get_slider_attacks(int square, const Board& board, bool bishop, bool rook);
 
+inline int magic_index(const Magic& m, u64 occupancy) {
+#ifdef USE_PEXT
+    return m.offset + (int)_pext_u64(occupancy, m.mask);
+#else
+    return m.offset + (int)(((occupancy & m.mask) * m.magic) >> m.shift);
+#endif
+}
+
+inline u64 bishop_attacks(int square, u64 occupancy) {
+    return bishop_attack_table[magic_index(bishop_magics[square], occupancy)];
+}
+
+inline u64 rook_attacks(int square, u64 occupancy) {
+    return rook_attack_table[magic_index(rook_magics[square], occupancy)];
+}
+
+inline u64 queen_attacks(int square, u64 occupancy) {
+    return bishop_attacks(square, occupancy) | rook_attacks(square, occupancy);
+}
+
+// Which subset of the pseudo-legal moves to generate
+enum GenType {
+    GEN_ALL,
+    GEN_CAPTURES, // Captures (including en passant) and all promotions
+    GEN_QUIETS    // Everything else, castling included
+};
+
+// Generates fully legal moves: pins and check evasions are resolved up front.
+// The generators are specialised on the side to move.
 class MoveGenerator {
 public:
-    static void generate_moves(const Board& board, std::vector<Move>& moves);
-    static void generate_captures(const Board& board, std::vector<Move>& moves);
-    static bool is_move_legal(Board& board, const Move& move);
+    static void generate_moves(const Board& board, MoveList& moves);
+    static void generate_captures(const Board& board, MoveList& moves);
+    static void generate_quiets(const Board& board, MoveList& moves);
+    
+    // Whether an arbitrary move, such as a hash or killer move from another
+    // position, is one the generator would produce here
+    static bool is_legal(const Board& board, const Move& move);
+    
+    // Per-position data shared by the piece generators
+    struct GenState {
+        u64 targets;     // Allowed destinations for non-king pieces
+        u64 check_mask;  // Evasion squares when in check, all squares otherwise
+        u64 pinned;      // Side-to-move pieces pinned to their king
+        int king_square;
+    };
     
 private:
-    static void generate_pawn_moves(const Board& board, std::vector<Move>& moves);
-    static void generate_knight_moves(const Board& board, std::vector<Move>& moves);
-    static void generate_bishop_moves(const Board& board, std::vector<Move>& moves);
-    static void generate_rook_moves(const Board& board, std::vector<Move>& moves);
-    static void generate_queen_moves(const Board& board, std::vector<Move>& moves);
-    static void generate_king_moves(const Board& board, std::vector<Move>& moves);
-    static void generate_castling_moves(const Board& board, std::vector<Move>& moves);
+    static void generate(const Board& board, MoveList& moves, GenType type);
+    
+    template <Color Us> static void generate(const Board& board, MoveList& moves, GenType type);
+    template <Color Us> static u64 pinned_pieces(const Board& board, int king_square);
+    template <Color Us> static bool is_legal(const Board& board, const Move& move);
+    template <Color Us> static void generate_pawn_moves(const Board& board, MoveList& moves, GenType type, const GenState& state);
+    template <Color Us> static void generate_knight_moves(const Board& board, MoveList& moves, const GenState& state);
+    template <Color Us> static void generate_bishop_moves(const Board& board, MoveList& moves, const GenState& state);
+    template <Color Us> static void generate_rook_moves(const Board& board, MoveList& moves, const GenState& state);
+    template <Color Us> static void generate_queen_moves(const Board& board, MoveList& moves, const GenState& state);
+    template <Color Us> static void generate_king_moves(const Board& board, MoveList& moves, u64 target_mask, const GenState& state);
+    template <Color Us> static void generate_castling_moves(const Board& board, MoveList& moves);
 };
 
 // UCI move conversion
@@ -0,0 +1,119 @@
+#include "perft.h"
+#include <chrono>
+#include <new>
+#include <thread>
+
+bool PerftTable::resize(size_t mb) {
+    if (mb == 0) {
+        entries.reset();
+        mask = 0;
+        return true;
+    }
+    
+    // Largest power of two number of entries that fits
+    size_t count = 1;
+    while (count * 2 * sizeof(Entry) <= mb * 1024 * 1024) count *= 2;
+    
+    // The old table stays in place if the new one cannot be allocated
+    std::unique_ptr<Entry[]> fresh(new (std::nothrow) Entry[count]);
+    if (!fresh) return false;
+    entries.swap(fresh);
+    mask = count - 1;
+    clear();
+    return true;
+}
+
+void PerftTable::clear() {
+    for (u64 i = 0; entries && i <= mask; i++) {
+        entries[i].check.store(0, std::memory_order_relaxed);
+        entries[i].data.store(0, std::memory_order_relaxed);
+    }
+}
+
+bool PerftTable::probe(u64 key, int depth, u64& nodes) const {
+    const Entry& entry = entries[(key ^ (u64)depth * 0x9E3779B97F4A7C15ULL) & mask];
+    u64 data = entry.data.load(std::memory_order_relaxed);
+    u64 check = entry.check.load(std::memory_order_relaxed);
+    if ((check ^ data) != key || (int)(data & 0xFF) != depth) return false;
+    nodes = data >> 8;
+    return true;
+}
+
+void PerftTable::store(u64 key, int depth, u64 nodes) {
+    Entry& entry = entries[(key ^ (u64)depth * 0x9E3779B97F4A7C15ULL) & mask];
+    u64 data = (nodes << 8) | (u64)depth;
+    entry.check.store(key ^ data, std::memory_order_relaxed);
+    entry.data.store(data, std::memory_order_relaxed);
+}
+
+u64 Perft::count(Board& board, int depth) {
+    MoveList moves;
+    MoveGenerator::generate_moves(board, moves);
+    
+    // The generator is legal, so the last ply is just the move count
+    if (depth == 1) return moves.size();
+    
+    u64 nodes = 0;
+    if (table.enabled() && table.probe(board.zobrist_key, depth, nodes)) return nodes;
+    
+    for (const Move& move : moves) {
+        Board::UndoInfo undo = board.make_move(move);
+        nodes += count(board, depth - 1);
+        board.undo_move(undo);
+    }
+    
+    if (table.enabled()) table.store(board.zobrist_key, depth, nodes);
+    return nodes;
+}
+
+u64 Perft::run(const Board& board, int depth, int threads, std::vector<RootResult>* divide) {
+    if (depth <= 0) return 1;
+    
+    MoveList root_moves;
+    MoveGenerator::generate_moves(board, root_moves);
+    
+    std::vector<u64> counts(root_moves.size(), 0);
+    std::atomic<int> next_move(0);
+    
+    // Each worker takes the next unclaimed root move on its own board copy
+    auto worker = [&]() {
+        Board local = board;
+        int i;
+        while ((i = next_move.fetch_add(1)) < root_moves.size()) {
+            Board::UndoInfo undo = local.make_move(root_moves[i]);
+            counts[i] = (depth == 1) ? 1 : count(local, depth - 1);
+            local.undo_move(undo);
+        }
+    };
+    
+    std::vector<std::thread> pool;
+    for (int t = 1; t < threads; t++) pool.emplace_back(worker);
+    worker();
+    for (std::thread& thread : pool) thread.join();
+    
+    u64 total = 0;
+    for (int i = 0; i < root_moves.size(); i++) {
+        total += counts[i];
+        if (divide) divide->push_back({root_moves[i], counts[i]});
+    }
+    return total;
+}
+
+u64 Perft::divide(const Board& board, int depth, int threads,
+                  const std::function<void(const std::string&)>& print) {
+    auto start = std::chrono::steady_clock::now();
+    
+    std::vector<RootResult> results;
+    u64 total = run(board, depth, threads, &results);
+    
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    
+    for (const RootResult& result : results) {
+        print(result.move.to_uci() + ": " + std::to_string(result.nodes));
+    }
+    print("Total: " + std::to_string(total));
+    print("info nodes " + std::to_string(total) + " time " + std::to_string(elapsed)
+          + " nps " + std::to_string(elapsed > 0 ? total * 1000 / elapsed : total));
+    return total;
+}
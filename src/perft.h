@@ -0,0 +1,56 @@
+#ifndef PERFT_H
+#define PERFT_H
+
+#include "board.h"
+#include "moves.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+// Perft node counts keyed by Zobrist key and depth. Entries are two
+// independent words, validated by storing key ^ data, so threads can share
+// the table without locking.
+class PerftTable {
+private:
+    struct Entry {
+        std::atomic<u64> check; // key ^ data
+        std::atomic<u64> data;  // nodes << 8 | depth
+    };
+    
+    std::unique_ptr<Entry[]> entries;
+    u64 mask = 0;
+    
+public:
+    bool resize(size_t mb); // false, keeping the old table, if out of memory
+    void clear();
+    bool enabled() const { return entries != nullptr; }
+    bool probe(u64 key, int depth, u64& nodes) const;
+    void store(u64 key, int depth, u64 nodes);
+};
+
+// Leaf counting for move generator validation and benchmarking: bulk counts
+// at depth 1, optional hashing and root moves split across threads
+class Perft {
+private:
+    PerftTable table;
+    
+    u64 count(Board& board, int depth);
+    
+public:
+    struct RootResult {
+        Move move;
+        u64 nodes;
+    };
+    
+    bool set_hash_size(size_t mb) { return table.resize(mb); }
+    void clear() { table.clear(); }
+    
+    u64 run(const Board& board, int depth, int threads, std::vector<RootResult>* divide = nullptr);
+    // Reports each root move's count, then the total, one line per call
+    // to print so the caller decides where and how output is written
+    u64 divide(const Board& board, int depth, int threads,
+               const std::function<void(const std::string&)>& print);
+};
+
+#endif
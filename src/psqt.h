@@ -0,0 +1,23 @@
+#ifndef PSQT_H
+#define PSQT_H
+
+#include "utils.h"
+#include <array>
+#include <cstdint>
+
+// A middle-game and an end-game value packed into one int, so both phases
+// are updated with a single add. The end-game half sits in the high bits.
+constexpr int make_score(int mg, int eg) { return (int)((unsigned)eg << 16) + mg; }
+inline int mg_value(int score) { return (int16_t)(uint16_t)(unsigned)score; }
+inline int eg_value(int score) { return (int16_t)(uint16_t)((unsigned)(score + 0x8000) >> 16); }
+
+// Material plus piece-square bonus for every piece on every square, from
+// white's point of view: black entries are negative. Kings carry no material.
+extern const std::array<std::array<int, 64>, 13> psq_table;
+
+// Contribution of each piece to the game phase, MAX_PHASE with all minor
+// and major pieces on the board
+extern const std::array<int, 13> phase_weight;
+constexpr int MAX_PHASE = 24;
+
+#endif
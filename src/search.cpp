@@ -2,74 +2,399 @@
 #include "evaluation.h"
 #include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <thread>
+
+// Entry data layout, see TTEntry
+static u64 pack_entry(int value, Move move, int depth, TTFlag flag, int age) {
+    return (u64)(uint32_t)value
+         | (u64)move.data << 32
+         | (u64)(uint8_t)depth << 48
+         | (u64)flag << 56
+         | (u64)age << 58;
+}
+
+static int entry_value(u64 data) { return (int32_t)(uint32_t)data; }
+static Move entry_move(u64 data) { Move move; move.data = (uint16_t)(data >> 32); return move; }
+static int entry_depth(u64 data) { return (int8_t)(uint8_t)(data >> 48); }
+static TTFlag entry_flag(u64 data) { return static_cast<TTFlag>((data >> 56) & 3); }
+static int entry_age(u64 data) { return (int)(data >> 58); }
+
+// Mate scores count plies from the root, but an entry can be reached at any
+// ply, so the table holds them counted from the node itself
+static int value_to_tt(int value, int ply) {
+    if (value >= MATE_BOUND) return value + ply;
+    if (value <= -MATE_BOUND) return value - ply;
+    return value;
+}
+
+static int value_from_tt(int value, int ply) {
+    if (value >= MATE_BOUND) return value - ply;
+    if (value <= -MATE_BOUND) return value + ply;
+    return value;
+}
+
+bool TranspositionTable::resize(size_t mb) {
+    // Largest power of two number of buckets that fits
+    size_t count = 1;
+    while (count * 2 * sizeof(TTBucket) <= mb * 1024 * 1024) count *= 2;
+    
+    // The old table stays in place if the new one cannot be allocated
+    std::unique_ptr<TTBucket[]> fresh(new (std::nothrow) TTBucket[count]);
+    if (!fresh) return false;
+    buckets.swap(fresh);
+    mask = count - 1;
+    clear();
+    return true;
+}
 
 void TranspositionTable::store(u64 key, int depth, int value, TTFlag flag, Move best_move) {
-    TTEntry entry;
-    entry.key = key;
-    entry.depth = depth;
-    entry.value = value;
-    entry.flag = flag;
-    entry.best_move = best_move;
-    entry.age = current_age;
-    table[key] = entry;
+    TTEntry* entries = bucket(key).entries;
+    TTEntry* replace = nullptr;
+    int replace_score = 0;
+    
+    for (int i = 0; i < TTBucket::SIZE; i++) {
+        TTEntry& entry = entries[i];
+        u64 data = entry.data.load(std::memory_order_relaxed);
+        
+        if ((entry.key.load(std::memory_order_relaxed) ^ data) == key) {
+            // Keep the old move when this search found none
+            if (best_move.is_null()) best_move = entry_move(data);
+            
+            // A much shallower non-exact result, such as a quiescence
+            // visit, must not wipe out a deeper bound; just refresh its move
+            if (flag != TT_EXACT && depth < entry_depth(data) - SAME_KEY_MARGIN) {
+                data = pack_entry(entry_value(data), best_move, entry_depth(data),
+                                  entry_flag(data), entry_age(data));
+                entry.key.store(key ^ data, std::memory_order_relaxed);
+                entry.data.store(data, std::memory_order_relaxed);
+                return;
+            }
+            replace = &entry;
+            break;
+        }
+        
+        // Evict the shallowest entry, counting each search it has
+        // survived as losing several plies
+        int score = entry_depth(data) - 8 * ((current_age - entry_age(data)) & AGE_MASK);
+        if (!replace || score < replace_score) {
+            replace = &entry;
+            replace_score = score;
+        }
+    }
+    
+    u64 data = pack_entry(value, best_move, depth, flag, current_age);
+    replace->key.store(key ^ data, std::memory_order_relaxed);
+    replace->data.store(data, std::memory_order_relaxed);
 }
 
 bool TranspositionTable::probe(u64 key, int depth, int& value, TTFlag& flag, Move& best_move) {
-    auto it = table.find(key);
-    if (it == table.end()) return false;
-    
-    TTEntry& entry = it->second;
-    if (entry.depth >= depth) {
-        value = entry.value;
-        flag = entry.flag;
-        best_move = entry.best_move;
+    TTEntry* entries = bucket(key).entries;
+    
+    for (int i = 0; i < TTBucket::SIZE; i++) {
+        u64 data = entries[i].data.load(std::memory_order_relaxed);
+        if ((entries[i].key.load(std::memory_order_relaxed) ^ data) != key) continue;
+        
+        // The move is useful for ordering even when the bound is too shallow
+        best_move = entry_move(data);
+        if (entry_depth(data) < depth) return false;
+        
+        value = entry_value(data);
+        flag = entry_flag(data);
         return true;
     }
     return false;
 }
 
 void TranspositionTable::clear() {
-    table.clear();
+    for (u64 i = 0; buckets && i <= mask; i++) {
+        for (TTEntry& entry : buckets[i].entries) {
+            entry.key.store(0, std::memory_order_relaxed);
+            entry.data.store(0, std::memory_order_relaxed);
+        }
+    }
     current_age = 0;
 }
 
+int TranspositionTable::hashfull() const {
+    // Permille of this search's entries in the first thousand buckets
+    u64 sample = std::min<u64>(mask + 1, 1000);
+    u64 used = 0;
+    for (u64 i = 0; i < sample; i++) {
+        for (const TTEntry& entry : buckets[i].entries) {
+            u64 data = entry.data.load(std::memory_order_relaxed);
+            used += data != 0 && entry_age(data) == current_age;
+        }
+    }
+    return (int)(used * 1000 / (sample * TTBucket::SIZE));
+}
+
+const std::vector<SearchParams::Option>& SearchParams::options() {
+    static const std::vector<Option> list = {
+        {"RFPDepth",       &SearchParams::rfp_depth,       0, 20},
+        {"RFPMargin",      &SearchParams::rfp_margin,      0, 500},
+        {"FutilityDepth",  &SearchParams::futility_depth,  0, 20},
+        {"FutilityMargin", &SearchParams::futility_margin, 0, 500},
+        {"FutilityBase",   &SearchParams::futility_base,   0, 500},
+        {"LMPDepth",       &SearchParams::lmp_depth,       0, 20},
+        {"LMPBase",        &SearchParams::lmp_base,        0, 50},
+        {"RazorDepth",     &SearchParams::razor_depth,     0, 10},
+        {"RazorMargin",    &SearchParams::razor_margin,    0, 1000},
+        {"LMRBase",        &SearchParams::lmr_base,        0, 300},
+        {"LMRDivisor",     &SearchParams::lmr_divisor,     50, 600},
+        {"LMRHistory",     &SearchParams::lmr_history,     1, 65536},
+    };
+    return list;
+}
+
+bool Searcher::set_param(const std::string& name, int value) {
+    for (const SearchParams::Option& option : SearchParams::options()) {
+        if (name != option.name) continue;
+        params.*option.value = std::max(option.min, std::min(option.max, value));
+        init_reductions();
+        return true;
+    }
+    return false;
+}
+
+void Searcher::init_reductions() {
+    // Late moves at high depth are reduced most: base + ln(depth) * ln(moves) / divisor
+    for (int depth = 0; depth <= MAX_DEPTH; depth++) {
+        for (int count = 0; count < 64; count++) {
+            double r = params.lmr_base / 100.0;
+            if (depth > 0 && count > 0) r += std::log(depth) * std::log(count) * 100.0 / params.lmr_divisor;
+            reductions[depth][count] = (depth > 0 && count > 0) ? (int)r : 0;
+        }
+    }
+}
+
+void Searcher::set_threads(int count) {
+    workers.clear();
+    for (int i = 0; i < std::max(1, count); i++) {
+        workers.emplace_back(new SearchWorker(*this, i));
+    }
+}
+
+void Searcher::clear() {
+    tt.clear();
+    for (auto& worker : workers) worker->clear();
+}
+
+u64 Searcher::nodes_searched() const {
+    u64 total = 0;
+    for (const auto& worker : workers) total += worker->nodes.load(std::memory_order_relaxed);
+    return total;
+}
+
 SearchStats Searcher::search(Board& board, const SearchLimits& limits) {
-    stats = SearchStats();
-    stop_search = false;
     tt.set_age(tt.current_age + 1);
+    this->limits = limits;
+    time.init(limits, board.side_to_move);
     
-    Move best_move;
-    int best_score = -1000000;
+    // Helpers run on copies of the position; the calling thread is worker 0
+    std::vector<std::thread> helpers;
+    for (size_t i = 1; i < workers.size(); i++) {
+        helpers.emplace_back(&SearchWorker::iterate, workers[i].get(), board, std::cref(limits));
+    }
+    workers[0]->iterate(board, limits);
+    
+    // UCI forbids a bestmove before stop (or ponderhit) in these modes,
+    // even when the depth ran out
+    while ((limits.infinite || pondering) && !stop_search) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    
+    stop_search = true;
+    for (std::thread& helper : helpers) helper.join();
+    
+    // Trust the deepest finished iteration, then the better score
+    SearchWorker* best = workers[0].get();
+    for (const auto& worker : workers) {
+        if (worker->stats.best_move.is_null()) continue;
+        if (worker->completed_depth > best->completed_depth
+            || (worker->completed_depth == best->completed_depth
+                && worker->stats.score > best->stats.score)) {
+            best = worker.get();
+        }
+    }
+    
+    SearchStats result = best->stats;
+    
+    // Stopped before depth 1 finished: any legal move beats none
+    if (result.best_move.is_null()) {
+        MoveList moves;
+        MoveGenerator::generate_moves(board, moves);
+        if (!moves.empty()) result.best_move = moves[0];
+    }
+    result.nodes = result.qnodes = result.tthits = 0;
+    for (const auto& worker : workers) {
+        result.nodes += worker->stats.nodes;
+        result.qnodes += worker->stats.qnodes;
+        result.tthits += worker->stats.tthits;
+    }
+    return result;
+}
+
+void SearchWorker::clear() {
+    stats = SearchStats();
+    std::fill(&history[0][0], &history[0][0] + 2 * 64 * 64, 0);
+    std::fill(&continuation_history[0][0][0][0], &continuation_history[0][0][0][0] + 13 * 64 * 13 * 64, 0);
+    std::fill(&countermoves[0][0], &countermoves[0][0] + 13 * 64, Move());
+}
+
+void SearchWorker::iterate(Board board, const SearchLimits& limits) {
+    stats = SearchStats();
+    nodes = 0;
+    completed_depth = 0;
+    int stability = 0;
+    
+    for (SearchStack& entry : stack) {
+        entry.static_eval = EVAL_NONE;
+        entry.current_move = Move();
+        entry.moved_piece = EMPTY;
+        entry.killers[0] = entry.killers[1] = Move();
+        entry.excluded_move = Move();
+        entry.pv_length = 0;
+    }
     
-    for (int depth = 1; depth <= limits.depth && !stop_search; depth++) {
+    // Later iterations reorder the list by subtree size
+    root_moves.clear();
+    const PieceToHistory* continuation[2] = {nullptr, nullptr};
+    MovePicker picker(board, Move(), frame(0)->killers, Move(), &history[board.side_to_move], continuation);
+    for (Move move; !(move = picker.next_move()).is_null(); ) root_moves.push_back({move, 0, {move}});
+    if (root_moves.empty()) return;
+    
+    // Odd helpers start a ply deeper so the threads spread over depths
+    int score = 0;
+    for (int depth = 1 + (id & 1); depth <= limits.depth && !searcher.stop_search; depth++) {
         stats.depth = depth;
         
-        int score = alpha_beta(board, depth, -1000000, 1000000, true);
+        // Start narrow around the last score and widen on each fail
+        int delta = ASPIRATION_WINDOW;
+        int alpha = -INFINITE_SCORE, beta = INFINITE_SCORE;
+        if (depth >= 4) {
+            alpha = std::max(score - delta, -INFINITE_SCORE);
+            beta = std::min(score + delta, INFINITE_SCORE);
+        }
         
-        if (!stop_search && score > best_score) {
-            best_score = score;
-            stats.score = score;
+        while (true) {
+            int result = search_root(board, depth, alpha, beta);
+            if (searcher.stop_search) break;
             
-            int tt_value;
-            TTFlag tt_flag;
-            Move tt_move;
-            if (tt.probe(board.zobrist_key, depth, tt_value, tt_flag, tt_move)) {
-                best_move = tt_move;
-                stats.best_move = tt_move;
+            if (result <= alpha) {
+                beta = (alpha + beta) / 2;
+                alpha = std::max(result - delta, -INFINITE_SCORE);
+            } else if (result >= beta) {
+                beta = std::min(result + delta, INFINITE_SCORE);
+            } else {
+                score = result;
+                break;
             }
+            delta += delta / 2;
         }
+        if (searcher.stop_search) break;
         
-        std::cerr << "info depth " << depth << " score cp " << score 
-                  << " nodes " << stats.nodes << std::endl;
+        completed_depth = depth;
+        stats.score = score;
+        stability = (root_moves[0].move == stats.best_move) ? stability + 1 : 0;
+        stats.best_move = root_moves[0].move;
         
-        if (stop_condition(limits)) break;
+        if (id == 0) {
+            u64 total = searcher.nodes_searched();
+            int64_t elapsed = searcher.time.elapsed();
+            std::string pv;
+            for (const Move& move : root_moves[0].pv) pv += " " + move.to_uci();
+            std::cerr << "info depth " << depth << " score cp " << score 
+                      << " nodes " << total << " time " << elapsed
+                      << " nps " << (elapsed > 0 ? total * 1000 / elapsed : total)
+                      << " hashfull " << searcher.tt.hashfull() << " pv" << pv << std::endl;
+            
+            // Another iteration would likely not finish inside the budget
+            if (!limits.infinite && !searcher.pondering && searcher.time.soft_expired(stability)) break;
+        }
     }
     
-    return stats;
+    stats.nodes = nodes;
 }
 
-int Searcher::alpha_beta(Board& board, int depth, int alpha, int beta, bool do_null) {
-    stats.nodes++;
+int SearchWorker::search_root(Board& board, int depth, int alpha, int beta) {
+    count_node();
+    
+    SearchStack* ss = frame(0);
+    ss->static_eval = board.in_check(board.side_to_move) ? EVAL_NONE : Evaluator::evaluate(board);
+    
+    int original_alpha = alpha;
+    int best_value = -INFINITE_SCORE;
+    int best_index = -1;
+    
+    for (size_t i = 0; i < root_moves.size(); i++) {
+        RootMove& root = root_moves[i];
+        u64 nodes_before = nodes.load(std::memory_order_relaxed);
+        ss->current_move = root.move;
+        ss->moved_piece = board.moved_piece(root.move);
+        Board::UndoInfo undo = board.make_move(root.move);
+        
+        int score;
+        if (i == 0) {
+            score = -alpha_beta(board, depth - 1, 1, -beta, -alpha, true);
+        } else {
+            score = -alpha_beta(board, depth - 1, 1, -alpha - 1, -alpha, true);
+            if (score > alpha && score < beta) {
+                score = -alpha_beta(board, depth - 1, 1, -beta, -alpha, true);
+            }
+        }
+        
+        board.undo_move(undo);
+        root.nodes = nodes.load(std::memory_order_relaxed) - nodes_before;
+        if (searcher.stop_search) return 0;
+        
+        if (score > best_value) {
+            best_value = score;
+            if (score > alpha) best_index = (int)i;
+        }
+        if (score > alpha) {
+            alpha = score;
+            const SearchStack* child = frame(1);
+            root.pv.assign(1, root.move);
+            root.pv.insert(root.pv.end(), child->pv, child->pv + child->pv_length);
+        }
+        if (alpha >= beta) break;
+    }
+    
+    // Next iteration: the best move first, the rest by how much work their
+    // subtrees took, which tracks how close they came to being best
+    if (best_index > 0) std::rotate(root_moves.begin(), root_moves.begin() + best_index, root_moves.begin() + best_index + 1);
+    std::stable_sort(root_moves.begin() + 1, root_moves.end(),
+                     [](const RootMove& a, const RootMove& b) { return a.nodes > b.nodes; });
+    
+    TTFlag flag = TT_EXACT;
+    if (best_value <= original_alpha) flag = TT_ALPHA;
+    else if (best_value >= beta) flag = TT_BETA;
+    searcher.tt.store(board.zobrist_key, depth, best_value, flag, root_moves[0].move);
+    
+    return best_value;
+}
+
+void SearchWorker::check_limits() {
+    if (searcher.limits.infinite || searcher.pondering) return;
+    
+    if (searcher.time.hard_expired()
+        || (searcher.limits.nodes > 0 && searcher.nodes_searched() >= searcher.limits.nodes)) {
+        searcher.stop_search = true;
+    }
+}
+
+int SearchWorker::alpha_beta(Board& board, int depth, int ply, int alpha, int beta, bool do_null) {
+    // The result of an aborted iteration is thrown away
+    if (searcher.stop_search.load(std::memory_order_relaxed)) return 0;
+    
+    count_node();
+    
+    SearchStack* ss = frame(ply);
+    ss->pv_length = 0;
     
     if (is_repetition(board, depth)) {
         return 0;
@@ -78,66 +403,113 @@ int Searcher::alpha_beta(Board& board, int depth, int alpha, int beta, bool do_n
     int tt_value;
     TTFlag tt_flag;
     Move tt_move;
-    bool tt_hit = tt.probe(board.zobrist_key, depth, tt_value, tt_flag, tt_move);
+    const bool excluding = !ss->excluded_move.is_null();
+    bool tt_hit = !excluding && searcher.tt.probe(board.zobrist_key, depth, tt_value, tt_flag, tt_move);
     if (tt_hit) {
         stats.tthits++;
+        tt_value = value_from_tt(tt_value, ply);
         if (tt_flag == TT_EXACT) return tt_value;
         if (tt_flag == TT_ALPHA && tt_value <= alpha) return alpha;
         if (tt_flag == TT_BETA && tt_value >= beta) return beta;
     }
     
-    if (depth <= 0) {
-        return quiescence(board, alpha, beta, 0);
+    if (depth <= 0 || ply >= MAX_PLY) {
+        return quiescence(board, alpha, beta, ply);
     }
     
-    if (do_null && depth >= 3 && !board.in_check(board.side_to_move)) {
-        // Create a null move
-        Move null_move = {0, 0, 0, 0, 0, false, false};
-        Board::UndoInfo undo = board.make_move(null_move);
-        int null_score = -alpha_beta(board, depth - 3, -beta, -beta + 1, false);
-        board.undo_move(undo);
-        
-        if (null_score >= beta) return beta;
-    }
+    const SearchParams& params = searcher.params;
+    const bool pv_node = beta - alpha > 1;
+    const bool in_check = board.in_check(board.side_to_move);
+    ss->static_eval = in_check ? EVAL_NONE : Evaluator::evaluate(board);
+    const int static_eval = ss->static_eval;
     
-    std::vector<Move> moves;
-    MoveGenerator::generate_moves(board, moves);
+    // A side whose eval rose over its last move is expected to keep finding
+    // good moves, so it is pruned harder above beta and less below alpha
+    const bool improving = !in_check
+        && ((ss - 2)->static_eval == EVAL_NONE || static_eval > (ss - 2)->static_eval);
     
-    if (moves.empty()) {
-        if (board.in_check(board.side_to_move)) {
-            return -1000000 + (100 - depth);
-        } else {
-            return 0;
+    // Grandchildren start from fresh killers
+    (ss + 2)->killers[0] = (ss + 2)->killers[1] = Move();
+    
+    if (!pv_node && !in_check) {
+        // Reverse futility: far enough above beta that a quiet move at this
+        // depth is not expected to lose it all
+        if (depth <= params.rfp_depth && std::abs(beta) < MATE_BOUND
+            && static_eval - params.rfp_margin * (depth - improving) >= beta) {
+            return static_eval;
+        }
+        
+        // Razoring: hopelessly below alpha, so only tactics can help
+        if (depth <= params.razor_depth && static_eval + params.razor_margin * depth < alpha) {
+            int score = quiescence(board, alpha - 1, alpha, ply);
+            if (score < alpha) return score;
         }
     }
     
-    order_moves(moves, tt_move, depth);
+    if (do_null && depth >= 3 && !in_check && !excluding && static_eval >= beta) {
+        ss->current_move = Move();
+        ss->moved_piece = EMPTY;
+        Board::UndoInfo undo = board.make_null_move();
+        int null_score = -alpha_beta(board, depth - 3, ply + 1, -beta, -beta + 1, false);
+        board.undo_null_move(undo);
+        
+        if (null_score >= beta) return beta;
+    }
+    
+    const PieceToHistory* continuation[2] = {continuation_table(ss - 1), continuation_table(ss - 2)};
+    MovePicker picker(board, tt_move, ss->killers, countermove(ss - 1),
+                      &history[board.side_to_move], continuation);
     
-    int best_value = -1000000;
-    Move best_move = moves[0];
+    int original_alpha = alpha;
+    int best_value = -INFINITE_SCORE;
+    Move best_move;
     int moves_searched = 0;
+    MoveList quiets_tried;
     
-    for (const Move& move : moves) {
-        Board::UndoInfo undo = board.make_move(move);
+    for (Move move; !(move = picker.next_move()).is_null(); ) {
+        if (move == ss->excluded_move) continue;
+        
+        bool quiet = !board.is_capture(move) && !move.is_promotion();
+        int move_history = quiet ? quiet_history(board, move, ss) : 0;
         
-        if (board.in_check((Color)(!board.side_to_move))) {
-            board.undo_move(undo);
-            continue;
+        // Quiet moves that cannot matter this close to the horizon, once
+        // one move has kept us out of a mated line
+        if (quiet && !in_check && moves_searched > 0 && best_value > -MATE_BOUND) {
+            int move_limit = (params.lmp_base + depth * depth) / (improving ? 1 : 2);
+            if (depth <= params.lmp_depth && moves_searched >= move_limit) continue;
+            if (depth <= params.futility_depth
+                && static_eval + params.futility_base + params.futility_margin * depth <= alpha) continue;
         }
         
+        ss->current_move = move;
+        ss->moved_piece = board.moved_piece(move);
+        Board::UndoInfo undo = board.make_move(move);
+        
         int score;
         if (moves_searched == 0) {
-            score = -alpha_beta(board, depth - 1, -beta, -alpha, true);
+            score = -alpha_beta(board, depth - 1, ply + 1, -beta, -alpha, true);
         } else {
-            int reduction = (depth >= 3 && moves_searched >= 4) ? 1 : 0;
-            score = -alpha_beta(board, depth - 1 - reduction, -alpha - 1, -alpha, true);
+            // Late quiet moves are reduced by the table, less for good history
+            // and on the principal variation
+            int reduction = 0;
+            if (depth >= 3 && quiet && !in_check) {
+                reduction = searcher.reductions[std::min(depth, MAX_DEPTH)][std::min(moves_searched, 63)];
+                reduction -= move_history / params.lmr_history;
+                if (pv_node) reduction--;
+                if (!improving) reduction++;
+                reduction = std::max(0, std::min(reduction, depth - 2));
+            }
+            score = -alpha_beta(board, depth - 1 - reduction, ply + 1, -alpha - 1, -alpha, true);
             
-            if (score > alpha) {
-                score = -alpha_beta(board, depth - 1, -beta, -alpha, true);
+            if (score > alpha && (reduction > 0 || score < beta)) {
+                score = -alpha_beta(board, depth - 1, ply + 1, -beta, -alpha, true);
             }
         }
         
         board.undo_move(undo);
+        
+        // An aborted child's score is meaningless; leave no trace of it
+        if (searcher.stop_search) return 0;
         moves_searched++;
         
         if (score > best_value) {
@@ -147,127 +519,161 @@ int Searcher::alpha_beta(Board& board, int depth, int alpha, int beta, bool do_n
         
         if (score > alpha) {
             alpha = score;
+            
+            // This move's line becomes the node's principal variation
+            const SearchStack* child = ss + 1;
+            ss->pv[0] = move;
+            std::copy(child->pv, child->pv + child->pv_length, ss->pv + 1);
+            ss->pv_length = child->pv_length + 1;
         }
         
         if (alpha >= beta) {
-            if (!move.captured) {
-                killer_moves[depth][1] = killer_moves[depth][0];
-                killer_moves[depth][0] = move;
+            if (quiet) {
+                if (ss->killers[0] != move) {
+                    ss->killers[1] = ss->killers[0];
+                    ss->killers[0] = move;
+                }
+                update_quiet_stats(board, move, quiets_tried, depth, ss);
             }
             break;
         }
+        
+        if (quiet) quiets_tried.push_back(move);
+    }
+    
+    if (moves_searched == 0) {
+        if (excluding) return alpha;
+        return in_check ? -INFINITE_SCORE + ply : 0;
     }
     
     TTFlag flag = TT_EXACT;
-    if (best_value <= alpha) flag = TT_ALPHA;
+    if (best_value <= original_alpha) flag = TT_ALPHA;
     else if (best_value >= beta) flag = TT_BETA;
     
-    tt.store(board.zobrist_key, depth, best_value, flag, best_move);
+    if (!excluding && !searcher.stop_search) {
+        searcher.tt.store(board.zobrist_key, depth, value_to_tt(best_value, ply), flag, best_move);
+    }
     
     return best_value;
 }
 
-int Searcher::quiescence(Board& board, int alpha, int beta, int depth) {
+int SearchWorker::quiescence(Board& board, int alpha, int beta, int ply) {
+    if (searcher.stop_search.load(std::memory_order_relaxed)) return 0;
+    
+    count_node();
     stats.qnodes++;
     
-    int stand_pat = Evaluator::evaluate(board);
-    if (stand_pat >= beta) return beta;
-    if (alpha < stand_pat) alpha = stand_pat;
+    if (ply >= MAX_PLY) return Evaluator::evaluate(board);
     
-    if (depth >= 8) return stand_pat;
+    // Any stored result resolves the same capture sequence
+    int tt_value;
+    TTFlag tt_flag;
+    Move tt_move;
+    if (searcher.tt.probe(board.zobrist_key, DEPTH_QS, tt_value, tt_flag, tt_move)) {
+        stats.tthits++;
+        tt_value = value_from_tt(tt_value, ply);
+        if (tt_flag == TT_EXACT
+            || (tt_flag == TT_ALPHA && tt_value <= alpha)
+            || (tt_flag == TT_BETA && tt_value >= beta)) {
+            return tt_value;
+        }
+    }
     
-    std::vector<Move> moves;
-    MoveGenerator::generate_captures(board, moves);
+    // In check there is no standing pat: every evasion is searched
+    const bool in_check = board.in_check(board.side_to_move);
+    int original_alpha = alpha;
+    int best_value = -INFINITE_SCORE;
+    int stand_pat = 0;
     
-    for (const Move& move : moves) {
-        Board::UndoInfo undo = board.make_move(move);
-        
-        if (board.in_check((Color)(!board.side_to_move))) {
-            board.undo_move(undo);
-            continue;
+    if (!in_check) {
+        stand_pat = Evaluator::evaluate(board);
+        if (stand_pat >= beta) {
+            searcher.tt.store(board.zobrist_key, DEPTH_QS, value_to_tt(stand_pat, ply), TT_BETA, Move());
+            return stand_pat;
+        }
+        if (stand_pat > alpha) alpha = stand_pat;
+        best_value = stand_pat;
+    }
+    
+    Move best_move;
+    int moves_searched = 0;
+    
+    MovePicker picker(board, tt_move, in_check);
+    for (Move move; !(move = picker.next_move()).is_null(); ) {
+        if (!in_check) {
+            // Delta pruning: even winning the piece outright stays below alpha
+            if (!move.is_promotion()
+                && stand_pat + piece_value(board.captured_piece(move)) + DELTA_MARGIN <= alpha) {
+                continue;
+            }
+            
+            // Losing the exchange cannot raise a stand-pat score
+            if (see(board, move) < 0) continue;
         }
         
-        int score = -quiescence(board, -beta, -alpha, depth + 1);
+        Board::UndoInfo undo = board.make_move(move);
+        int score = -quiescence(board, -beta, -alpha, ply + 1);
         board.undo_move(undo);
+        if (searcher.stop_search) return 0;
+        moves_searched++;
         
-        if (score >= beta) return beta;
+        if (score > best_value) {
+            best_value = score;
+            best_move = move;
+        }
         if (score > alpha) alpha = score;
+        if (alpha >= beta) break;
     }
     
-    return alpha;
-}
-
-void Searcher::order_moves(std::vector<Move>& moves, const Move& tt_move, int depth) const {
-    std::sort(moves.begin(), moves.end(), [&](const Move& a, const Move& b) {
-        return score_move(a, tt_move, depth) > score_move(b, tt_move, depth);
-    });
-}
-
-int Searcher::score_move(const Move& move, const Move& tt_move, int depth) const {
-    if (move == tt_move) return 10000;
+    if (in_check && moves_searched == 0) return -INFINITE_SCORE + ply;
     
-    if (move.captured) {
-        return 9000 + PIECE_VALUES[move.captured] - PIECE_VALUES[move.piece] / 10;
-    }
+    TTFlag flag = TT_EXACT;
+    if (best_value <= original_alpha) flag = TT_ALPHA;
+    else if (best_value >= beta) flag = TT_BETA;
+    if (!searcher.stop_search) searcher.tt.store(board.zobrist_key, DEPTH_QS, value_to_tt(best_value, ply), flag, best_move);
     
-    for (int i = 0; i < 2; i++) {
-        if (move == killer_moves[depth][i]) return 8000 - i;
+    return best_value;
+}
+
+int SearchWorker::quiet_history(const Board& board, const Move& move, const SearchStack* ss) const {
+    int piece = board.moved_piece(move);
+    int score = history[board.side_to_move][move.from_to()];
+    for (const SearchStack* prev : {ss - 1, ss - 2}) {
+        if (const PieceToHistory* table = continuation_table(prev)) score += (*table)[piece][move.to()];
     }
-    
-    int history_score = 0; // Simplified for now
-    if (move.promotion) return 7000 + PIECE_VALUES[move.promotion];
-    
-    return history_score;
+    return score;
 }
 
-bool Searcher::is_repetition(const Board& board, int ply) const {
-    (void)board; (void)ply;
-    return false;
+// Gravity update: the step shrinks as the entry nears the bound, so scores
+// saturate instead of overflowing and recent results still move them
+template<typename T>
+static void update_history(T& entry, int bonus, int max) {
+    entry += bonus - entry * std::abs(bonus) / max;
 }
 
-bool Searcher::stop_condition(const SearchLimits& limits) const {
-    if (stop_search) return true;
+void SearchWorker::update_quiet_stats(const Board& board, const Move& best, const MoveList& quiets, int depth, SearchStack* ss) {
+    int bonus = std::min(32 * depth * depth, 2048);
+    Color us = board.side_to_move;
     
-    auto now = std::chrono::steady_clock::now();
-    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - limits.start_time);
+    auto update = [&](const Move& move, int amount) {
+        int piece = board.moved_piece(move);
+        update_history(history[us][move.from_to()], amount, MAX_HISTORY);
+        for (const SearchStack* prev : {ss - 1, ss - 2}) {
+            if (prev->current_move.is_null()) continue;
+            update_history(continuation_history[prev->moved_piece][prev->current_move.to()][piece][move.to()],
+                           amount, MAX_HISTORY);
+        }
+    };
     
-    if (limits.movetime > 0 && elapsed.count() >= limits.movetime) return true;
-    if (limits.nodes > 0 && stats.nodes >= limits.nodes) return true;
+    // The cutoff move is rewarded and the quiets tried before it penalised
+    update(best, bonus);
+    for (const Move& move : quiets) update(move, -bonus);
     
-    return false;
+    const SearchStack* last = ss - 1;
+    if (!last->current_move.is_null()) countermoves[last->moved_piece][last->current_move.to()] = best;
 }
 
-u64 Searcher::perft(Board& board, int depth) {
-    if (depth == 0) return 1;
-    
-    std::vector<Move> moves;
-    MoveGenerator::generate_moves(board, moves);
-    
-    u64 nodes = 0;
-    for (const Move& move : moves) {
-        Board::UndoInfo undo = board.make_move(move);
-        if (!board.in_check((Color)(!board.side_to_move))) {
-            nodes += perft(board, depth - 1);
-        }
-        board.undo_move(undo);
-    }
-    return nodes;
+bool SearchWorker::is_repetition(const Board& board, int ply) const {
+    (void)board; (void)ply;
+    return false;
 }
-
-u64 Searcher::divide(Board& board, int depth) {
-    std::vector<Move> moves;
-    MoveGenerator::generate_moves(board, moves);
-    
-    u64 total = 0;
-    for (const Move& move : moves) {
-        Board::UndoInfo undo = board.make_move(move);
-        if (!board.in_check((Color)(!board.side_to_move))) {
-            u64 count = (depth == 1) ? 1 : perft(board, depth - 1);
-            std::cout << move.to_uci() << ": " << count << std::endl;
-            total += count;
-        }
-        board.undo_move(undo);
-    }
-    std::cout << "Total: " << total << std::endl;
-    return total;
-}
\ No newline at end of file
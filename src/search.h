@@ -3,74 +3,221 @@
 
 #include "board.h"
 #include "moves.h"
-#include <unordered_map>
+#include "movepick.h"
+#include "timeman.h"
+#include <atomic>
+#include <memory>
+#include <vector>
 #include <chrono>
+#include <string>
+
+constexpr int MAX_DEPTH = 64;
+constexpr int MAX_PLY = 128;
+
+// Hash entries written by quiescence, below any main search depth
+constexpr int DEPTH_QS = -1;
+
+constexpr int INFINITE_SCORE = 1000000;
+constexpr int MATE_BOUND = INFINITE_SCORE - MAX_PLY; // Scores beyond are mates
+
+// Pruning and reduction margins, each exposed as a UCI spin option
+struct SearchParams {
+    int rfp_depth = 6;
+    int rfp_margin = 80;         // per ply
+    int futility_depth = 6;
+    int futility_margin = 90;    // per ply, on top of futility_base
+    int futility_base = 60;
+    int lmp_depth = 6;
+    int lmp_base = 3;            // quiets allowed at depth d: base + d * d
+    int razor_depth = 3;
+    int razor_margin = 200;      // per ply
+    int lmr_base = 75;           // hundredths of a ply
+    int lmr_divisor = 225;       // hundredths
+    int lmr_history = 8192;      // history per ply of reduction removed
+    
+    struct Option {
+        const char* name;
+        int SearchParams::* value;
+        int min;
+        int max;
+    };
+    static const std::vector<Option>& options();
+};
 
 struct SearchLimits {
     int depth = 6;
     int movetime = 0;
-    int nodes = 0;
+    int wtime = 0;
+    int btime = 0;
+    int winc = 0;
+    int binc = 0;
+    int movestogo = 0;
+    u64 nodes = 0;
     bool infinite = false;
+    bool ponder = false;
     std::chrono::steady_clock::time_point start_time;
 };
 
 struct SearchStats {
-    int nodes = 0;
-    int qnodes = 0;
-    int tthits = 0;
+    u64 nodes = 0;
+    u64 qnodes = 0;
+    u64 tthits = 0;
     int depth = 0;
     int score = 0;
     Move best_move;
 };
 
-enum TTFlag { TT_EXACT, TT_ALPHA, TT_BETA };
+enum TTFlag : uint8_t { TT_EXACT, TT_ALPHA, TT_BETA };
 
+// Two words, the key stored XORed with the data. A torn write from another
+// thread leaves a pair that fails validation, so the table needs no locks.
 struct TTEntry {
-    u64 key;
-    int depth;
-    int value;
-    TTFlag flag;
-    Move best_move;
-    int age;
+    std::atomic<u64> key;  // position key ^ data
+    std::atomic<u64> data; // value | move << 32 | depth << 48 | flag << 56 | age << 58
 };
 
+struct alignas(64) TTBucket {
+    static constexpr int SIZE = 4;
+    TTEntry entries[SIZE];
+};
+
+static_assert(sizeof(TTEntry) == 16, "TTEntry must stay 16 bytes");
+static_assert(sizeof(TTBucket) == 64, "TTBucket must fill one cache line");
+
+// Fixed-size table of power-of-two buckets shared by all search threads. A
+// position only ever lives in the bucket picked by its low key bits, so a
+// probe touches one cache line.
 class TranspositionTable {
 private:
-    std::unordered_map<u64, TTEntry> table;
+    std::unique_ptr<TTBucket[]> buckets;
+    u64 mask = 0;
+    
+    TTBucket& bucket(u64 key) { return buckets[key & mask]; }
     
 public:
+    static constexpr int AGE_MASK = 63;
+    static constexpr int SAME_KEY_MARGIN = 2; // plies a same-key store may lose
+    static constexpr size_t DEFAULT_MB = 16;
+    
     int current_age = 0;
+    
+    TranspositionTable() { resize(DEFAULT_MB); }
+    
+    bool resize(size_t mb); // false, keeping the old table, if out of memory
     void store(u64 key, int depth, int value, TTFlag flag, Move best_move);
     bool probe(u64 key, int depth, int& value, TTFlag& flag, Move& best_move);
     void clear();
-    void set_age(int age) { current_age = age; }
-    int size() const { return table.size(); }
+    void set_age(int age) { current_age = age & AGE_MASK; }
+    int hashfull() const;
 };
 
-class Searcher {
+class Searcher;
+
+// One search thread's state. Heuristics and counters are private to the
+// thread; the transposition table and stop flag belong to the Searcher.
+class SearchWorker {
+    friend class Searcher;
+    
 private:
-    TranspositionTable tt;
+    Searcher& searcher;
+    const int id;
+    
     SearchStats stats;
-    int history[2][64][64];
-    Move killer_moves[100][2];
-    bool stop_search = false;
+    std::atomic<u64> nodes{0};
+    int completed_depth = 0;
     
-    int quiescence(Board& board, int alpha, int beta, int depth);
-    int alpha_beta(Board& board, int depth, int alpha, int beta, bool do_null);
+    struct RootMove {
+        Move move;
+        u64 nodes;             // subtree size in the last iteration
+        std::vector<Move> pv;  // set while the move is best
+    };
+    std::vector<RootMove> root_moves;
     
-    int score_move(const Move& move, const Move& tt_move, int depth) const;
-    void order_moves(std::vector<Move>& moves, const Move& tt_move, int depth) const;
+    ButterflyHistory history[2];                 // [color][Move::from_to()]
+    PieceToHistory continuation_history[13][64]; // [previous piece][previous to]
+    Move countermoves[13][64];                   // [previous piece][previous to]
+    
+    // Per-ply node state, filled on entry and read by the plies around it.
+    // Two sentinel frames sit below the root so ss - 2 is always valid, and
+    // two above the deepest ply for the children a node prepares.
+    struct SearchStack {
+        int static_eval;   // EVAL_NONE when in check
+        Move current_move; // null for a null move
+        int moved_piece;   // EMPTY for a null move
+        Move killers[2];
+        Move excluded_move;
+        int pv_length;
+        Move pv[MAX_PLY];
+    };
+    static constexpr int EVAL_NONE = INFINITE_SCORE + 1;
+    SearchStack stack[MAX_PLY + 4];
+    SearchStack* frame(int ply) { return &stack[ply + 2]; }
+    
+    static constexpr u64 CHECK_INTERVAL = 1024; // nodes between clock checks
+    static constexpr int ASPIRATION_WINDOW = 25;
+    static constexpr int DELTA_MARGIN = 200;
+    
+    void count_node() {
+        u64 count = nodes.load(std::memory_order_relaxed) + 1;
+        nodes.store(count, std::memory_order_relaxed);
+        if (id == 0 && count % CHECK_INTERVAL == 0) check_limits();
+    }
+    void check_limits();
+    
+    void iterate(Board board, const SearchLimits& limits);
+    int search_root(Board& board, int depth, int alpha, int beta);
+    int quiescence(Board& board, int alpha, int beta, int ply);
+    int alpha_beta(Board& board, int depth, int ply, int alpha, int beta, bool do_null);
+    
+    // Null when the previous frame holds a null move or a root sentinel,
+    // which would otherwise all share the [EMPTY][0] slot
+    const PieceToHistory* continuation_table(const SearchStack* prev) const {
+        return prev->current_move.is_null() ? nullptr : &continuation_history[prev->moved_piece][prev->current_move.to()];
+    }
+    Move countermove(const SearchStack* prev) const {
+        return prev->current_move.is_null() ? Move() : countermoves[prev->moved_piece][prev->current_move.to()];
+    }
+    int quiet_history(const Board& board, const Move& move, const SearchStack* ss) const;
+    void update_quiet_stats(const Board& board, const Move& best, const MoveList& quiets, int depth, SearchStack* ss);
     
     bool is_repetition(const Board& board, int ply) const;
-    bool stop_condition(const SearchLimits& limits) const;
     
 public:
+    SearchWorker(Searcher& s, int thread_id) : searcher(s), id(thread_id) { clear(); }
+    void clear();
+};
+
+// Lazy SMP: every thread searches the same root on its own board and
+// heuristics, and they share what they learn through the hash table.
+class Searcher {
+    friend class SearchWorker;
+    
+private:
+    TranspositionTable tt;
+    TimeManager time;
+    SearchLimits limits;
+    SearchParams params;
+    int reductions[MAX_DEPTH + 1][64]; // [depth][move number], in plies
+    std::vector<std::unique_ptr<SearchWorker>> workers;
+    std::atomic<bool> stop_search{false};
+    std::atomic<bool> pondering{false};
+    
+    void init_reductions();
+    
+public:
+    Searcher() { init_reductions(); set_threads(1); }
+    
+    // Call before handing the search to another thread, so a stop sent
+    // straight after go cannot be lost
+    void prepare(const SearchLimits& limits) { stop_search = false; pondering = limits.ponder; }
     SearchStats search(Board& board, const SearchLimits& limits);
     void stop() { stop_search = true; }
-    void clear() { tt.clear(); stats = SearchStats(); }
-    
-    u64 perft(Board& board, int depth);
-    u64 divide(Board& board, int depth);
+    void ponderhit() { pondering = false; }
+    void clear();
+    bool set_hash_size(size_t mb) { return tt.resize(mb); }
+    void set_threads(int count);
+    bool set_param(const std::string& name, int value);
+    u64 nodes_searched() const;
 };
 
-#endif
\ No newline at end of file
+#endif
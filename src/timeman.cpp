@@ -0,0 +1,40 @@
+#include "timeman.h"
+#include "search.h"
+#include <algorithm>
+
+void TimeManager::init(const SearchLimits& limits, Color us) {
+    start = limits.start_time;
+    soft = hard = 0;
+    fixed = false;
+    
+    if (limits.movetime > 0) {
+        soft = hard = limits.movetime;
+        fixed = true;
+        return;
+    }
+    
+    int64_t time = us == WHITE ? limits.wtime : limits.btime;
+    int64_t inc = us == WHITE ? limits.winc : limits.binc;
+    if (time <= 0) return;
+    
+    // Sudden death is treated as 30 moves to go
+    int64_t moves_to_go = limits.movestogo > 0 ? std::min(limits.movestogo, 50) : 30;
+    int64_t available = std::max<int64_t>(1, time - MOVE_OVERHEAD);
+    
+    hard = std::max<int64_t>(1, std::min(available * 4 / 5, (available / moves_to_go + inc) * 4));
+    soft = std::min(hard, available / moves_to_go + inc * 3 / 4);
+}
+
+int64_t TimeManager::elapsed() const {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count();
+}
+
+bool TimeManager::soft_expired(int stability) const {
+    if (!limited() || fixed) return false;
+    
+    // Spend longer while the best move keeps changing, less once it settles
+    static constexpr int SCALE[] = {140, 110, 90, 80, 70}; // percent
+    int64_t budget = soft * SCALE[std::min(stability, 4)] / 100;
+    return elapsed() >= std::min(budget, hard);
+}
@@ -0,0 +1,31 @@
+#ifndef TIMEMAN_H
+#define TIMEMAN_H
+
+#include "utils.h"
+#include <chrono>
+#include <cstdint>
+
+struct SearchLimits;
+
+// Turns the go parameters into two budgets: a soft one checked between
+// iterations and scaled by best-move stability, and a hard one the search
+// polls while running and never exceeds.
+class TimeManager {
+private:
+    std::chrono::steady_clock::time_point start;
+    int64_t soft = 0; // ms, 0 when unlimited
+    int64_t hard = 0;
+    bool fixed = false; // go movetime: use all of it, no soft stop
+    
+public:
+    static constexpr int64_t MOVE_OVERHEAD = 30; // ms kept back for I/O lag
+    
+    void init(const SearchLimits& limits, Color us);
+    
+    int64_t elapsed() const;
+    bool limited() const { return hard > 0; }
+    bool soft_expired(int stability) const;
+    bool hard_expired() const { return limited() && elapsed() >= hard; }
+};
+
+#endif
@@ -1,15 +1,20 @@
 #include "uci.h"
 #include "evaluation.h"
 #include <iostream>
+#include <algorithm>
+#include <charconv>
 
 void UCI::run() {
     is_running = true;
-    std::cout << "YM07 Chess Engine" << std::endl;
+    send("YM07 Chess Engine");
     
     std::string line;
     while (is_running && std::getline(std::cin, line)) {
         process_command(line);
     }
+    
+    // Input closed mid-search
+    finish_search();
 }
 
 void UCI::process_command(const std::string& command) {
@@ -29,6 +34,8 @@ void UCI::process_command(const std::string& command) {
         handle_go(ss);
     } else if (token == "stop") {
         handle_stop();
+    } else if (token == "ponderhit") {
+        handle_ponderhit();
     } else if (token == "quit") {
         handle_quit();
     } else if (token == "setoption") {
@@ -38,23 +45,34 @@ void UCI::process_command(const std::string& command) {
     } else if (token == "print") {
         print_board();
     } else if (token == "eval") {
-        std::cout << "eval: " << Evaluator::evaluate(board) << std::endl;
+        send("eval: " + std::to_string(Evaluator::evaluate(board)));
     } else if (!token.empty()) {
-        std::cout << "Unknown command: " << token << std::endl;
+        send("Unknown command: " + token);
     }
 }
 
 void UCI::handle_uci() {
-    std::cout << "id name YM07 Chess Engine" << std::endl;
-    std::cout << "id author Kayzori" << std::endl;
-    std::cout << "uciok" << std::endl;
+    send("id name YM07 Chess Engine");
+    send("id author Kayzori");
+    send("option name Hash type spin default " + std::to_string(TranspositionTable::DEFAULT_MB)
+         + " min 1 max " + std::to_string(MAX_HASH_MB));
+    send("option name Threads type spin default 1 min 1 max " + std::to_string(MAX_THREADS));
+    send("option name PerftHash type spin default 0 min 0 max " + std::to_string(MAX_PERFT_HASH_MB));
+    
+    const SearchParams defaults;
+    for (const SearchParams::Option& option : SearchParams::options()) {
+        send(std::string("option name ") + option.name + " type spin default " + std::to_string(defaults.*option.value)
+             + " min " + std::to_string(option.min) + " max " + std::to_string(option.max));
+    }
+    send("uciok");
 }
 
 void UCI::handle_isready() {
-    std::cout << "readyok" << std::endl;
+    send("readyok");
 }
 
 void UCI::handle_ucinewgame() {
+    wait_for_search();
     searcher.clear();
     board.set_from_fen("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
 }
@@ -65,17 +83,21 @@ void UCI::handle_position(std::stringstream& ss) {
     
     if (token == "startpos") {
         board.set_from_fen("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+        ss >> token;
     } else if (token == "fen") {
+        // The FEN runs up to the optional "moves" keyword
         std::string fen;
-        ss >> fen;
+        while (ss >> token && token != "moves") {
+            fen += token + " ";
+        }
         board.set_from_fen(fen);
     }
     
     // Parse moves
-    else if (token == "moves") {
+    if (token == "moves") {
         while (ss >> token) {
             Move move = uci_to_move(token, board);
-            if (move.from != -1)board.make_move(move);
+            if (!move.is_null()) board.make_move(move);
         }
     }
 }
@@ -84,36 +106,135 @@ void UCI::handle_go(std::stringstream& ss) {
     SearchLimits limits;
     limits.start_time = std::chrono::steady_clock::now();
     
+    bool depth_set = false;
     std::string token;
     while (ss >> token) {
-        if (token == "depth") {
+        if (token == "perft") {
+            int depth = 1;
+            ss >> depth;
+            wait_for_search();
+            perft.divide(board, depth, threads, [this](const std::string& line) { send(line); });
+            return;
+        } else if (token == "depth") {
             ss >> limits.depth;
+            depth_set = true;
         } else if (token == "movetime") {
             ss >> limits.movetime;
+        } else if (token == "wtime") {
+            ss >> limits.wtime;
+        } else if (token == "btime") {
+            ss >> limits.btime;
+        } else if (token == "winc") {
+            ss >> limits.winc;
+        } else if (token == "binc") {
+            ss >> limits.binc;
+        } else if (token == "movestogo") {
+            ss >> limits.movestogo;
         } else if (token == "nodes") {
             ss >> limits.nodes;
         } else if (token == "infinite") {
             limits.infinite = true;
+        } else if (token == "ponder") {
+            limits.ponder = true;
         }
     }
     
-    SearchStats stats = searcher.search(board, limits);
-    std::cout << "bestmove " << stats.best_move.to_uci() << std::endl;
+    // Any other limit replaces the default depth rather than adding to it
+    bool other_limit = limits.movetime || limits.wtime || limits.btime || limits.nodes
+                    || limits.infinite || limits.ponder;
+    if (!depth_set && other_limit) limits.depth = MAX_DEPTH;
+    
+    // The search owns a copy, so the input loop stays free to take
+    // commands while it runs
+    wait_for_search();
+    searcher.prepare(limits);
+    search_waits_for_stop = limits.infinite || limits.ponder;
+    search_thread = std::thread([this, limits, position = board]() mutable {
+        SearchStats stats = searcher.search(position, limits);
+        send("bestmove " + stats.best_move.to_uci());
+    });
 }
 
 void UCI::handle_stop() {
-    searcher.stop();
+    wait_for_search();
+}
+
+void UCI::handle_ponderhit() {
+    searcher.ponderhit();
 }
 
 void UCI::handle_quit() {
+    wait_for_search();
     is_running = false;
 }
 
+void UCI::wait_for_search() {
+    if (!search_thread.joinable()) return;
+    searcher.stop();
+    search_thread.join();
+}
+
+// Lets a search with a finite limit run to completion; only searches that
+// would otherwise wait for a stop forever are cut short
+void UCI::finish_search() {
+    if (!search_thread.joinable()) return;
+    if (search_waits_for_stop) searcher.stop();
+    search_thread.join();
+}
+
+void UCI::send(const std::string& line) const {
+    std::lock_guard<std::mutex> lock(output_mutex);
+    std::cout << line << std::endl;
+}
+
+// Whole-string integer parse; GUIs can send anything as a value
+static bool parse_int(const std::string& text, int& value) {
+    const char* end = text.data() + text.size();
+    auto result = std::from_chars(text.data(), end, value);
+    return result.ec == std::errc() && result.ptr == end;
+}
+
 void UCI::handle_setoption(std::stringstream& ss) {
-    // Option handling not implemented
-    std::string token;
+    // setoption name <id> [value <x>]
+    std::string token, name, value;
+    ss >> token;
+    while (ss >> token && token != "value") {
+        name += (name.empty() ? "" : " ") + token;
+    }
     while (ss >> token) {
-        // Parse options
+        value += (value.empty() ? "" : " ") + token;
+    }
+    
+    bool known = name == "Hash" || name == "Threads" || name == "PerftHash"
+              || std::any_of(SearchParams::options().begin(), SearchParams::options().end(),
+                             [&](const SearchParams::Option& option) { return name == option.name; });
+    if (!known) {
+        send("Unknown option: " + name);
+        return;
+    }
+    
+    int number;
+    if (!parse_int(value, number)) {
+        send("Invalid value for " + name + ": " + value);
+        return;
+    }
+    
+    // Workers and the table are rebuilt, so no search may be running
+    wait_for_search();
+    
+    if (name == "Hash") {
+        if (!searcher.set_hash_size(std::max(1, std::min(MAX_HASH_MB, number)))) {
+            send("info string not enough memory for Hash " + std::to_string(number) + ", table unchanged");
+        }
+    } else if (name == "Threads") {
+        threads = std::max(1, std::min(MAX_THREADS, number));
+        searcher.set_threads(threads);
+    } else if (name == "PerftHash") {
+        if (!perft.set_hash_size(std::max(0, std::min(MAX_PERFT_HASH_MB, number)))) {
+            send("info string not enough memory for PerftHash " + std::to_string(number) + ", table unchanged");
+        }
+    } else {
+        searcher.set_param(name, number);
     }
 }
 
@@ -125,28 +246,23 @@ void UCI::handle_debug(std::stringstream& ss) {
 
 void UCI::print_board() const {
     for (int r = 7; r >= 0; r--) {
-        std::cout << r + 1 << " ";
+        std::string row = std::to_string(r + 1) + " ";
         for (int f = 0; f < 8; f++) {
-            int sq = r * 8 + f;
-            char pc = '.';
-            for (int p = 1; p <= 12; p++) {
-                if (board.pieces[p] & (1ULL << sq)) {
-                    pc = piece_to_char(p);
-                    break;
-                }
-            }
-            std::cout << pc << " ";
+            char pc = piece_to_char(board.piece_on(r * 8 + f));
+            row += pc;
+            row += ' ';
         }
-        std::cout << std::endl;
+        send(row);
     }
-    std::cout << "  a b c d e f g h" << std::endl;
-    std::cout << "FEN: " << board.to_fen() << std::endl;
-    std::cout << "Side: " << (board.side_to_move == WHITE ? "white" : "black") << std::endl;
+    send("  a b c d e f g h");
+    send("FEN: " + board.to_fen());
+    send(std::string("Side: ") + (board.side_to_move == WHITE ? "white" : "black"));
 }
 
-void UCI::print_moves(const std::vector<Move>& moves) const {
+void UCI::print_moves(const MoveList& moves) const {
+    std::string line;
     for (const auto& move : moves) {
-        std::cout << move.to_uci() << " ";
+        line += move.to_uci() + " ";
     }
-    std::cout << std::endl;
+    send(line);
 }
\ No newline at end of file
@@ -3,14 +3,27 @@
 
 #include "board.h"
 #include "search.h"
+#include "perft.h"
+#include <mutex>
 #include <string>
 #include <sstream>
+#include <thread>
 
 class UCI {
 private:
     Board& board;
     Searcher& searcher;
+    Perft perft;
     bool is_running = false;
+    std::thread search_thread;
+    bool search_waits_for_stop = false; // go infinite or go ponder
+    mutable std::mutex output_mutex;
+    
+    // UCI options
+    static constexpr int MAX_HASH_MB = 4096;
+    static constexpr int MAX_THREADS = 256;
+    static constexpr int MAX_PERFT_HASH_MB = 4096;
+    int threads = 1;
     
     // Command handlers
     void handle_uci();
@@ -19,16 +32,23 @@ private:
     void handle_position(std::stringstream& ss);
     void handle_go(std::stringstream& ss);
     void handle_stop();
+    void handle_ponderhit();
     void handle_quit();
     void handle_setoption(std::stringstream& ss);
     void handle_debug(std::stringstream& ss);
     
+    // Search thread
+    void wait_for_search();
+    void finish_search();
+    void send(const std::string& line) const; // the only writer to stdout
+    
     // Utility functions
     void print_board() const;
-    void print_moves(const std::vector<Move>& moves) const;
+    void print_moves(const MoveList& moves) const;
     
 public:
     UCI(Board& b, Searcher& s) : board(b), searcher(s) {}
+    ~UCI() { wait_for_search(); }
     void run();
     void process_command(const std::string& command);
 };
@@ -1,24 +1,39 @@
 #include "utils.h"
 #include "board.h"
-#include <random>
 
-// Zobrist keys
-u64 zobrist_piece[13][64];
-u64 zobrist_castle[16];
-u64 zobrist_enpassant[64];
-u64 zobrist_side;
-std::mt19937_64 rng(0xC0FFEE123456ULL);
+// SplitMix64 over the key index: a fixed, well-mixed sequence that can be
+// evaluated by the compiler
+static constexpr u64 zobrist_random(u64 index) {
+    u64 z = 0xC0FFEE123456ULL + (index + 1) * 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
 
-void init_zobrist() {
+// Zobrist keys
+constexpr std::array<std::array<u64, 64>, 13> zobrist_piece = [] {
+    std::array<std::array<u64, 64>, 13> keys{};
     for (int p = 0; p < 13; p++)
         for (int s = 0; s < 64; s++)
-            zobrist_piece[p][s] = rng();
+            keys[p][s] = zobrist_random(p * 64 + s);
+    return keys;
+}();
+
+constexpr std::array<u64, 16> zobrist_castle = [] {
+    std::array<u64, 16> keys{};
     for (int i = 0; i < 16; i++)
-        zobrist_castle[i] = rng();
+        keys[i] = zobrist_random(13 * 64 + i);
+    return keys;
+}();
+
+constexpr std::array<u64, 64> zobrist_enpassant = [] {
+    std::array<u64, 64> keys{};
     for (int s = 0; s < 64; s++)
-        zobrist_enpassant[s] = rng();
-    zobrist_side = rng();
-}
+        keys[s] = zobrist_random(13 * 64 + 16 + s);
+    return keys;
+}();
+
+constexpr u64 zobrist_side = zobrist_random(13 * 64 + 16 + 64);
 
 u64 compute_zobrist_key(const Board& b) {
     u64 h = 0;
@@ -5,6 +5,11 @@
 #include <cstdint>
 #include <string>
 #include <vector>
+#include <array>
+
+#if defined(USE_POPCNT) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
 using u64 = uint64_t;
 
@@ -18,7 +23,29 @@ enum Piece {
     BLACK_ROOK = 10, BLACK_QUEEN = 11, BLACK_KING = 12 
 };
 
-// Pure C++ bitboard utilities (no compiler intrinsics)
+inline Color piece_color(int piece) { return piece <= WHITE_KING ? WHITE : BLACK; }
+
+// Bitboard utilities. USE_POPCNT (CMake option YM07_USE_POPCNT) selects the
+// compiler builtins, which become POPCNT/TZCNT on x86-64; without it the
+// portable pure C++ versions are used.
+#if defined(USE_POPCNT) && defined(_MSC_VER)
+inline int bit_scan_forward(u64 b) {
+    unsigned long index;
+    return _BitScanForward64(&index, b) ? (int)index : 64;
+}
+
+inline int popcount(u64 b) {
+    return (int)__popcnt64(b);
+}
+#elif defined(USE_POPCNT)
+inline int bit_scan_forward(u64 b) {
+    return b ? __builtin_ctzll(b) : 64;
+}
+
+inline int popcount(u64 b) {
+    return __builtin_popcountll(b);
+}
+#else
 inline int bit_scan_forward(u64 b) {
     if (b == 0) return 64;
     
@@ -47,27 +74,34 @@ inline int popcount(u64 b) {
     }
     return count;
 }
+#endif
 
 inline u64 lsb(u64 b) { 
     return b & (~b + 1ULL);
 }
 
+// File and rank masks
+constexpr u64 FILE_A_BB = 0x0101010101010101ULL;
+constexpr u64 FILE_H_BB = FILE_A_BB << 7;
+constexpr u64 RANK_1_BB = 0xFFULL;
+constexpr u64 rank_bb(int rank) { return RANK_1_BB << (8 * rank); }
+constexpr u64 file_bb(int file) { return FILE_A_BB << file; }
+
 // Square utilities
 const int SQ_NONE = -1;
-inline int sq_index(int rank, int file) { return rank * 8 + file; }
-inline int rank_of(int sq) { return sq >> 3; }
-inline int file_of(int sq) { return sq & 7; }
+constexpr int sq_index(int rank, int file) { return rank * 8 + file; }
+constexpr int rank_of(int sq) { return sq >> 3; }
+constexpr int file_of(int sq) { return sq & 7; }
 
 // Piece character conversion
 int char_to_piece(char c);
 char piece_to_char(int piece);
 
-// Zobrist hashing
-extern u64 zobrist_piece[13][64];
-extern u64 zobrist_castle[16];
-extern u64 zobrist_enpassant[64];
-extern u64 zobrist_side;
-void init_zobrist();
+// Zobrist hashing keys, generated at compile time
+extern const std::array<std::array<u64, 64>, 13> zobrist_piece;
+extern const std::array<u64, 16> zobrist_castle;
+extern const std::array<u64, 64> zobrist_enpassant;
+extern const u64 zobrist_side;
 u64 compute_zobrist_key(const class Board& b);
 
 #endif
\ No newline at end of file
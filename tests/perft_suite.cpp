@@ -0,0 +1,112 @@
+#include "board.h"
+#include "moves.h"
+#include "perft.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Runs every "fen ;D<depth> <nodes> ..." line of an EPD file through perft
+// and exits non-zero on any mismatch.
+//
+// Usage: perft_suite <file.epd> [max depth] [threads]
+
+struct PerftCase {
+    std::string fen;
+    int depth;
+    u64 expected;
+};
+
+static std::vector<PerftCase> load_cases(const std::string& path, int max_depth) {
+    std::vector<PerftCase> cases;
+    std::ifstream file(path);
+    std::string line;
+
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') continue;
+
+        std::stringstream ss(line);
+        std::string fen, field;
+        std::getline(ss, fen, ';');
+        fen.erase(fen.find_last_not_of(" \t") + 1);
+
+        while (std::getline(ss, field, ';')) {
+            std::stringstream fs(field);
+            std::string tag;
+            u64 nodes;
+            if (!(fs >> tag >> nodes) || tag.size() < 2 || tag[0] != 'D') continue;
+
+            int depth = std::stoi(tag.substr(1));
+            if (depth <= max_depth) cases.push_back({fen, depth, nodes});
+        }
+    }
+    return cases;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " <file.epd> [max depth] [threads]" << std::endl;
+        return 2;
+    }
+
+    init_move_tables();
+
+    int max_depth = argc > 2 ? std::atoi(argv[2]) : 64;
+    int threads = argc > 3 ? std::atoi(argv[3]) : (int)std::thread::hardware_concurrency();
+    threads = std::max(1, threads);
+
+    std::vector<PerftCase> cases = load_cases(argv[1], max_depth);
+    if (cases.empty()) {
+        std::cerr << "no perft cases in " << argv[1] << std::endl;
+        return 2;
+    }
+
+    std::atomic<size_t> next_case(0);
+    std::atomic<u64> total_nodes(0);
+    std::atomic<int> failures(0);
+    std::mutex output;
+
+    // Whole positions are the unit of work, each worker running its own perft
+    auto worker = [&]() {
+        Perft perft;
+        size_t i;
+        while ((i = next_case.fetch_add(1)) < cases.size()) {
+            const PerftCase& test = cases[i];
+            Board board;
+            board.set_from_fen(test.fen);
+
+            u64 nodes = perft.run(board, test.depth, 1);
+            total_nodes += nodes;
+
+            if (nodes != test.expected) {
+                failures++;
+                std::lock_guard<std::mutex> lock(output);
+                std::cout << "FAIL " << test.fen << " depth " << test.depth
+                          << ": expected " << test.expected << ", got " << nodes << std::endl;
+            }
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> pool;
+    for (int t = 1; t < threads; t++) pool.emplace_back(worker);
+    worker();
+    for (std::thread& thread : pool) thread.join();
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count();
+
+    std::cout << cases.size() - failures << "/" << cases.size() << " passed, "
+              << total_nodes << " nodes in " << elapsed << " ms ("
+              << (elapsed > 0 ? total_nodes * 1000 / elapsed : total_nodes.load())
+              << " nps, " << threads << " threads)" << std::endl;
+
+    return failures == 0 ? 0 : 1;
+}